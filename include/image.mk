@@ -296,12 +296,18 @@ define Build/patch-cmdline
 	$(STAGING_DIR_HOST)/bin/patch-cmdline $@ '$(CMDLINE)'
 endef
 
+# $(1): input file
+# $(2): optional block size to pad the appended data to
+define append_file
+	$(if $(2),dd if=$(1) bs=$(2) conv=sync,cat $(1)) >> $@
+endef
+
 define Build/append-kernel
-	dd if=$(word 1,$^) $(if $(1),bs=$(1) conv=sync) >> $@
+	$(call append_file,$(word 1,$^),$(1))
 endef
 
 define Build/append-rootfs
-	dd if=$(word 2,$^) $(if $(1),bs=$(1) conv=sync) >> $@
+	$(call append_file,$(word 2,$^),$(1))
 endef
 
 define Build/pad-rootfs
@@ -315,8 +321,7 @@ define Build/pad-offset
 		offset="$(word 2, $(1))" \
 		pad="(pad - ((size + offset) % pad)) % pad" \
 		newsize='size + pad'; \
-		dd if=$@ of=$@.new bs=$$newsize count=1 conv=sync
-	mv $@.new $@
+		dd if=/dev/null of=$@ bs=1 count=0 seek=$$newsize
 endef
 
 define Build/check-size
@@ -17,39 +17,153 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/percpu.h>
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,0,0)
+#define skb_vlan_tag_present(skb)	vlan_tx_tag_present(skb)
+#define skb_vlan_tag_get_id(skb)	vlan_tx_tag_get_id(skb)
+#endif
 
 static LIST_HEAD(trelay_devs);
 static struct dentry *debugfs_dir;
 
+struct trelay_stats {
+	u64 packets;
+	u64 bytes;
+	u64 dropped;
+	struct u64_stats_sync syncp;
+};
+
+struct trelay_port {
+	struct trelay *tr;
+	struct net_device *dev;
+	struct net_device *peer;
+	struct trelay_stats __percpu *stats;
+};
+
 struct trelay {
 	struct list_head list;
 	struct net_device *dev1, *dev2;
+	struct trelay_port port1, port2;
 	struct dentry *debugfs;
+	u16 vlan;
 	char name[];
 };
 
+static u16 trelay_vlan_id(struct sk_buff *skb)
+{
+	struct vlan_hdr *vhdr;
+
+	if (skb_vlan_tag_present(skb))
+		return skb_vlan_tag_get_id(skb);
+
+	if (skb->protocol != htons(ETH_P_8021Q) ||
+	    !pskb_may_pull(skb, VLAN_HLEN))
+		return 0;
+
+	vhdr = (struct vlan_hdr *) skb->data;
+	return ntohs(vhdr->h_vlan_TCI) & VLAN_VID_MASK;
+}
+
 rx_handler_result_t trelay_handle_frame(struct sk_buff **pskb)
 {
-	struct net_device *dev;
+	struct trelay_port *port;
+	struct trelay_stats *stats;
 	struct sk_buff *skb = *pskb;
+	unsigned int len;
+	int ret;
 
-	dev = rcu_dereference(skb->dev->rx_handler_data);
-	if (!dev)
+	port = rcu_dereference(skb->dev->rx_handler_data);
+	if (!port)
 		return RX_HANDLER_PASS;
 
 	if (skb->protocol == htons(ETH_P_PAE))
 		return RX_HANDLER_PASS;
 
+	/* with a VLAN set only its frames are relayed, the rest is local */
+	if (port->tr->vlan && trelay_vlan_id(skb) != port->tr->vlan)
+		return RX_HANDLER_PASS;
+
 	skb_push(skb, ETH_HLEN);
-	skb->dev = dev;
+	skb->dev = port->peer;
 	skb_forward_csum(skb);
-	dev_queue_xmit(skb);
+	len = skb->len;
+	ret = dev_queue_xmit(skb);
+
+	stats = this_cpu_ptr(port->stats);
+	u64_stats_update_begin(&stats->syncp);
+	if (net_xmit_eval(ret) == NET_XMIT_SUCCESS) {
+		stats->packets++;
+		stats->bytes += len;
+	} else {
+		stats->dropped++;
+	}
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_CONSUMED;
 }
 
+static void trelay_port_stats(struct trelay_port *port, u64 *packets,
+			      u64 *bytes, u64 *dropped)
+{
+	int cpu;
+
+	*packets = *bytes = *dropped = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct trelay_stats *stats = per_cpu_ptr(port->stats, cpu);
+		u64 p, b, d;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			p = stats->packets;
+			b = stats->bytes;
+			d = stats->dropped;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		*packets += p;
+		*bytes += b;
+		*dropped += d;
+	}
+}
+
+static int trelay_stats_show(struct seq_file *s, void *unused)
+{
+	struct trelay *tr = s->private;
+	struct trelay_port *ports[] = { &tr->port1, &tr->port2 };
+	u64 packets, bytes, dropped;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ports); i++) {
+		trelay_port_stats(ports[i], &packets, &bytes, &dropped);
+		seq_printf(s, "%s -> %s: packets %llu bytes %llu dropped %llu\n",
+			   ports[i]->dev->name, ports[i]->peer->name,
+			   packets, bytes, dropped);
+	}
+
+	return 0;
+}
+
+static int trelay_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trelay_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_stats = {
+	.owner = THIS_MODULE,
+	.open = trelay_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int trelay_open(struct inode *inode, struct file *file)
 {
 	file->private_data = inode->i_private;
@@ -60,13 +174,16 @@ static int trelay_do_remove(struct trelay *tr)
 {
 	list_del(&tr->list);
 
-	dev_put(tr->dev1);
-	dev_put(tr->dev2);
-
+	/* waits for the frames still being relayed through the ports */
 	netdev_rx_handler_unregister(tr->dev1);
 	netdev_rx_handler_unregister(tr->dev2);
 
+	dev_put(tr->dev1);
+	dev_put(tr->dev2);
+
 	debugfs_remove_recursive(tr->debugfs);
+	free_percpu(tr->port1.stats);
+	free_percpu(tr->port2.stats);
 	kfree(tr);
 
 	return 0;
@@ -126,6 +243,22 @@ static const struct file_operations fops_remove = {
 };
 
 
+static int trelay_port_init(struct trelay_port *port, struct trelay *tr)
+{
+	int cpu;
+
+	port->stats = alloc_percpu(struct trelay_stats);
+	if (!port->stats)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(port->stats, cpu)->syncp);
+
+	port->tr = tr;
+
+	return 0;
+}
+
 static int trelay_do_add(char *name, char *devn1, char *devn2)
 {
 	struct net_device *dev1, *dev2;
@@ -136,8 +269,16 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!tr)
 		return -ENOMEM;
 
+	/* alloc_percpu() may sleep, do it before taking any locks */
+	ret = trelay_port_init(&tr->port1, tr);
+	if (ret < 0)
+		goto out_free;
+
+	ret = trelay_port_init(&tr->port2, tr);
+	if (ret < 0)
+		goto out_free;
+
 	rtnl_lock();
-	rcu_read_lock();
 
 	ret = -EEXIST;
 	list_for_each_entry(tr1, &trelay_devs, list) {
@@ -146,16 +287,19 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	}
 
 	ret = -ENOENT;
-	dev1 = dev_get_by_name_rcu(&init_net, devn1);
-	dev2 = dev_get_by_name_rcu(&init_net, devn2);
+	dev1 = __dev_get_by_name(&init_net, devn1);
+	dev2 = __dev_get_by_name(&init_net, devn2);
 	if (!dev1 || !dev2)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, dev2);
+	tr->port1.dev = tr->port2.peer = dev1;
+	tr->port2.dev = tr->port1.peer = dev2;
+
+	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, &tr->port1);
 	if (ret < 0)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, dev1);
+	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, &tr->port2);
 	if (ret < 0) {
 		netdev_rx_handler_unregister(dev1);
 		goto out;
@@ -171,13 +315,19 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 
 	tr->debugfs = debugfs_create_dir(name, debugfs_dir);
 	debugfs_create_file("remove", S_IWUSR, tr->debugfs, tr, &fops_remove);
+	debugfs_create_file("stats", S_IRUSR, tr->debugfs, tr, &fops_stats);
+	debugfs_create_u16("vlan", S_IRUSR | S_IWUSR, tr->debugfs, &tr->vlan);
 	ret = 0;
 
 out:
-	rcu_read_unlock();
 	rtnl_unlock();
-	if (ret < 0)
-		kfree(tr);
+	if (!ret)
+		return 0;
+
+out_free:
+	free_percpu(tr->port1.stats);
+	free_percpu(tr->port2.stats);
+	kfree(tr);
 
 	return ret;
 }
@@ -12,12 +12,12 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
  */
-#include <sys/mman.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <mtd/mtd-user.h>
 #include "crc32.h"
 #include "mtd.h"
 #include "fis.h"
@@ -44,25 +44,34 @@ struct fis_image_desc {
 
 static int fis_fd = -1;
 static struct fis_image_desc *fis_desc;
+static unsigned char *fis_orig;
 static int fis_erasesize = 0;
+static int fis_count = 0;
 
 static void
 fis_close(void)
 {
-	if (fis_desc)
-		munmap(fis_desc, fis_erasesize);
+	free(fis_desc);
+	free(fis_orig);
 
 	if (fis_fd >= 0)
 		close(fis_fd);
 
 	fis_fd = -1;
 	fis_desc = NULL;
+	fis_orig = NULL;
+	fis_count = 0;
 }
 
+/*
+ * Read the FIS directory erase block once and keep a pristine copy of it,
+ * so fis_commit() can tell which bytes actually changed.
+ */
 static struct fis_image_desc *
 fis_open(void)
 {
 	struct fis_image_desc *desc;
+	int n;
 
 	if (fis_fd >= 0)
 		fis_close();
@@ -71,17 +80,27 @@ fis_open(void)
 	if (fis_fd < 0)
 		goto error;
 
-	close(fis_fd);
-	fis_fd = mtd_open("FIS directory", true);
-	if (fis_fd < 0)
-		goto error;
-
 	fis_erasesize = erasesize;
-	desc = mmap(NULL, erasesize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_LOCKED, fis_fd, 0);
-	if (desc == MAP_FAILED)
+	desc = malloc(erasesize);
+	fis_orig = malloc(erasesize);
+	if (!desc || !fis_orig) {
+		free(desc);
 		goto error;
+	}
 
 	fis_desc = desc;
+	if (pread(fis_fd, fis_orig, erasesize, 0) != erasesize)
+		goto error;
+
+	memcpy(desc, fis_orig, erasesize);
+
+	n = fis_erasesize / sizeof(struct fis_image_desc);
+	for (fis_count = 0; fis_count < n; fis_count++) {
+		if (!desc[fis_count].hdr.name[0] ||
+		    (desc[fis_count].hdr.name[0] == 0xff))
+			break;
+	}
+
 	return desc;
 
 error:
@@ -89,11 +108,79 @@ error:
 	return NULL;
 }
 
+static struct fis_image_desc *
+fis_find(const unsigned char *name)
+{
+	int i;
+
+	for (i = 0; i < fis_count; i++) {
+		if (!strncmp((char *) fis_desc[i].hdr.name, (char *) name,
+			     sizeof(fis_desc[i].hdr.name)))
+			return &fis_desc[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Write back only the changed part of the directory. NOR flash can clear
+ * bits without an erase, so if no bit has to go from 0 to 1 the changed
+ * range is programmed in place, otherwise the block is erased and
+ * rewritten.
+ */
+static int
+fis_commit(void)
+{
+	unsigned char *buf = (unsigned char *) fis_desc;
+	int first, last, i;
+
+	for (first = 0; first < fis_erasesize; first++)
+		if (buf[first] != fis_orig[first])
+			break;
+
+	if (first == fis_erasesize) {
+		if (!quiet)
+			fprintf(stderr, "FIS table unchanged\n");
+		return 0;
+	}
+
+	for (last = fis_erasesize - 1; last > first; last--)
+		if (buf[last] != fis_orig[last])
+			break;
+
+	if (mtdtype == MTD_NORFLASH) {
+		for (i = first; i <= last; i++)
+			if ((fis_orig[i] & buf[i]) != buf[i])
+				break;
+
+		if (i > last) {
+			if (!quiet)
+				fprintf(stderr, "Writing %d bytes of the FIS table in place\n",
+					last - first + 1);
+
+			if (pwrite(fis_fd, buf + first, last - first + 1, first) !=
+			    last - first + 1)
+				return -1;
+
+			return 0;
+		}
+	}
+
+	if (mtd_erase_block(fis_fd, 0) < 0) {
+		fprintf(stderr, "Failed to erase the FIS directory\n");
+		return -1;
+	}
+
+	if (pwrite(fis_fd, buf, fis_erasesize, 0) != fis_erasesize)
+		return -1;
+
+	return 0;
+}
+
 int
 fis_validate(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 {
 	struct fis_image_desc *desc;
-	void *end;
 	int found = 0;
 	int i;
 
@@ -109,21 +196,9 @@ fis_validate(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 		}
 	}
 
-	end = desc;
-	end = (char *) end + fis_erasesize;
-	while ((void *) desc < end) {
-		if (!desc->hdr.name[0] || (desc->hdr.name[0] == 0xff))
-			break;
-
-		for (i = 0; i < n_old; i++) {
-			if (!strncmp((char *) desc->hdr.name, (char *) old[i].name, sizeof(desc->hdr.name))) {
-				found++;
-				goto next;
-			}
-		}
-next:
-		desc++;
-		continue;
+	for (i = 0; i < n_old; i++) {
+		if (fis_find(old[i].name))
+			found++;
 	}
 
 	if (found == n_old)
@@ -148,7 +223,7 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 	struct fis_image_desc *desc;
 	struct fis_part *part;
 	uint32_t offset = 0, size = 0;
-	char *start, *end, *tmp;
+	char *end, *tmp;
 	int i;
 
 	desc = fis_open();
@@ -158,12 +233,8 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 	if (!quiet)
 		fprintf(stderr, "Updating FIS table... \n");
 
-	start = (char *) desc;
 	end = (char *) desc + fis_erasesize;
-	while ((char *) desc < end) {
-		if (!desc->hdr.name[0] || (desc->hdr.name[0] == 0xff))
-			break;
-
+	for (; desc < fis_desc + fis_count; desc++) {
 		if (!strcmp((char *) desc->hdr.name, "FIS directory"))
 			fisdir = desc;
 
@@ -182,9 +253,7 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 				break;
 			}
 		}
-		desc++;
 	}
-	desc--;
 
 	first_fb = first;
 	last_fb = last;
@@ -195,18 +264,11 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 	}
 
 	/* determine size of available space */
-	desc = (struct fis_image_desc *) start;
-	while ((char *) desc < end) {
-		if (!desc->hdr.name[0] || (desc->hdr.name[0] == 0xff))
-			break;
-
+	for (desc = fis_desc; desc < fis_desc + fis_count; desc++) {
 		if (desc->hdr.flash_base > last_fb->hdr.flash_base &&
 		    desc->hdr.flash_base < offset)
 			offset = desc->hdr.flash_base;
-
-		desc++;
 	}
-	desc--;
 
 	size = offset - first_fb->hdr.flash_base;
 
@@ -235,7 +297,7 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 		memmove(desc, last, end - tmp);
 		if (desc < last) {
 			tmp = end - (last - desc) * sizeof(struct fis_image_desc);
-			memset(tmp, 0xff, tmp - end);
+			memset(tmp, 0xff, end - tmp);
 		}
 	}
 
@@ -255,8 +317,8 @@ fis_remap(struct fis_part *old, int n_old, struct fis_part *new, int n_new)
 		size -= desc->hdr.size;
 	}
 
-	msync(fis_desc, fis_erasesize, MS_SYNC|MS_INVALIDATE);
+	i = fis_commit();
 	fis_close();
 
-	return 0;
+	return i;
 }
@@ -502,6 +502,9 @@ resume:
 			if (r == 0)
 				break;
 
+			if (trx_stream)
+				trx_stream(buf + buflen, r);
+
 			buflen += r;
 		}
 
@@ -608,6 +611,12 @@ resume:
 		offset = 0;
 	}
 
+	/* the data has been checked while writing, refuse to fix up a corrupt image */
+	if (trx_stream_verify && trx_stream_verify() < 0) {
+		fprintf(stderr, "Image verification failed.\n");
+		exit(1);
+	}
+
 	if (jffs2_replaced && trx_fixup) {
 		trx_fixup(fd, mtd);
 	}
@@ -102,6 +102,53 @@ err:
 }
 
 #ifndef target_ar71xx
+/* state for verifying the image crc while it is being written */
+static struct {
+	int active;
+	uint32_t len;
+	uint32_t crc32;
+	uint32_t pos;
+	uint32_t val;
+} stream;
+
+void
+trx_stream(const char *buf, int len)
+{
+	uint32_t start = offsetof(struct trx_header, flag_version);
+	uint32_t end = stream.pos + len;
+
+	if (!stream.active)
+		return;
+
+	if (end > stream.len)
+		end = stream.len;
+	if (start < stream.pos)
+		start = stream.pos;
+
+	if (start < end)
+		stream.val = crc32(stream.val, buf + (start - stream.pos), end - start);
+	stream.pos += len;
+}
+
+int
+trx_stream_verify(void)
+{
+	if (!stream.active)
+		return 0;
+
+	if (stream.pos < stream.len) {
+		fprintf(stderr, "Image truncated, got %u of %u bytes\n", stream.pos, stream.len);
+		return -1;
+	}
+
+	if (stream.val != stream.crc32) {
+		fprintf(stderr, "Bad trx crc32 got %08x, calculated %08x\n", stream.crc32, stream.val);
+		return -1;
+	}
+
+	return 0;
+}
+
 int
 trx_check(int imagefd, const char *mtd, char *buf, int *len)
 {
@@ -140,6 +187,14 @@ trx_check(int imagefd, const char *mtd, char *buf, int *len)
 	}
 
 	close(fd);
+
+	stream.active = 1;
+	stream.len = STORE32_LE(trx->len);
+	stream.crc32 = STORE32_LE(trx->crc32);
+	stream.pos = 0;
+	stream.val = 0xFFFFFFFF;
+	trx_stream(buf, *len);
+
 	return 1;
 }
 #endif
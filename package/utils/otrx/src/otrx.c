@@ -11,11 +11,16 @@
 
 #include <byteswap.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 
 #if __BYTE_ORDER == __BIG_ENDIAN
 #define cpu_to_le32(x)	bswap_32(x)
@@ -31,6 +36,10 @@
 #define TRX_FLAGS_OFFSET		12
 #define TRX_MAX_PARTS			3
 
+#define OTRX_CRC32_MAX_THREADS		8
+#define OTRX_CRC32_MIN_CHUNK		(1024 * 1024)
+#define OTRX_COPY_BUF_SIZE		(64 * 1024)
+
 struct trx_header {
 	uint32_t magic;
 	uint32_t length;
@@ -48,7 +57,10 @@ char *partition[TRX_MAX_PARTS] = {};
  * CRC32
  **************************************************/
 
-uint32_t otrx_crc32(uint8_t *buf, size_t len) {
+/* Slicing-by-8 tables, generated from the bytewise one on first use */
+static uint32_t otrx_crc32_slice[8][256];
+
+static void otrx_crc32_init(void) {
 	static const uint32_t t[] = {
 		0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
 		0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
@@ -115,17 +127,238 @@ uint32_t otrx_crc32(uint8_t *buf, size_t len) {
 		0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
 		0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 	};
-	uint32_t crc = 0xffffffff;
+	int i, j;
+
+	if (otrx_crc32_slice[1][1])
+		return;
+
+	for (i = 0; i < 256; i++) {
+		otrx_crc32_slice[0][i] = t[i];
+		for (j = 1; j < 8; j++)
+			otrx_crc32_slice[j][i] = (otrx_crc32_slice[j - 1][i] >> 8) ^
+				t[otrx_crc32_slice[j - 1][i] & 0xff];
+	}
+}
+
+/*
+ * Updates a (not inverted) CRC32 with the data in buf, processing 8 bytes
+ * per step with the slicing-by-8 tables
+ */
+static uint32_t otrx_crc32_update(uint32_t crc, const uint8_t *buf, size_t len) {
+	const uint32_t (*t)[256] = otrx_crc32_slice;
+	uint32_t lo, hi;
+
+	otrx_crc32_init();
+
+	while (len && ((uintptr_t)buf & 3)) {
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= 8) {
+		lo = crc ^ le32_to_cpu(*(const uint32_t *)buf);
+		hi = le32_to_cpu(*(const uint32_t *)(buf + 4));
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		      t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+		      t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+		buf += 8;
+		len -= 8;
+	}
 
 	while (len) {
-		crc = t[(crc ^ *buf) & 0xff] ^ (crc >> 8);
-		buf++;
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
 		len--;
 	}
 
 	return crc;
 }
 
+/*
+ * CRC32 combination as done by zlib: the CRC of the concatenation of two
+ * blocks is computed from their (regular, inverted) CRCs by applying len2
+ * zero bytes to crc1 with GF(2) matrix operations.
+ */
+static uint32_t otrx_gf2_times(const uint32_t *mat, uint32_t vec) {
+	uint32_t sum = 0;
+
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void otrx_gf2_square(uint32_t *square, const uint32_t *mat) {
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = otrx_gf2_times(mat, mat[n]);
+}
+
+static uint32_t otrx_crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+	uint32_t even[32];
+	uint32_t odd[32];
+	uint32_t row;
+	int n;
+
+	if (!len2)
+		return crc1;
+
+	/* operator for one zero bit */
+	odd[0] = 0xedb88320;
+	row = 1;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	otrx_gf2_square(even, odd);	/* two zero bits */
+	otrx_gf2_square(odd, even);	/* four zero bits */
+
+	/* apply len2 zero bytes, the first square gives one zero byte */
+	do {
+		otrx_gf2_square(even, odd);
+		if (len2 & 1)
+			crc1 = otrx_gf2_times(even, crc1);
+		len2 >>= 1;
+		if (!len2)
+			break;
+
+		otrx_gf2_square(odd, even);
+		if (len2 & 1)
+			crc1 = otrx_gf2_times(odd, crc1);
+		len2 >>= 1;
+	} while (len2);
+
+	return crc1 ^ crc2;
+}
+
+struct otrx_crc32_chunk {
+	pthread_t thread;
+	const uint8_t *buf;
+	size_t len;
+	uint32_t crc;
+};
+
+static void *otrx_crc32_thread(void *arg) {
+	struct otrx_crc32_chunk *chunk = arg;
+
+	chunk->crc = ~otrx_crc32_update(0xffffffff, chunk->buf, chunk->len);
+
+	return NULL;
+}
+
+/*
+ * Calculates the TRX CRC32 (initialized with ~0, not inverted at the end).
+ * Big buffers are split into chunks that are hashed on all online CPUs and
+ * combined afterwards.
+ */
+uint32_t otrx_crc32(uint8_t *buf, size_t len) {
+	struct otrx_crc32_chunk chunk[OTRX_CRC32_MAX_THREADS];
+	size_t chunk_len;
+	uint32_t crc;
+	long n;
+	int i;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > OTRX_CRC32_MAX_THREADS)
+		n = OTRX_CRC32_MAX_THREADS;
+	if (n > (long)(len / OTRX_CRC32_MIN_CHUNK))
+		n = len / OTRX_CRC32_MIN_CHUNK;
+	if (n < 2)
+		return otrx_crc32_update(0xffffffff, buf, len);
+
+	otrx_crc32_init();
+
+	chunk_len = (len / n) & ~7;
+	for (i = 0; i < n; i++) {
+		chunk[i].buf = buf + i * chunk_len;
+		chunk[i].len = (i == n - 1) ? len - i * chunk_len : chunk_len;
+
+		/* the first chunk is hashed by this thread */
+		if (i && pthread_create(&chunk[i].thread, NULL, otrx_crc32_thread, &chunk[i])) {
+			chunk[i].thread = 0;
+			otrx_crc32_thread(&chunk[i]);
+		}
+	}
+
+	otrx_crc32_thread(&chunk[0]);
+	crc = chunk[0].crc;
+	for (i = 1; i < n; i++) {
+		if (chunk[i].thread)
+			pthread_join(chunk[i].thread, NULL);
+		crc = otrx_crc32_combine(crc, chunk[i].crc, chunk[i].len);
+	}
+
+	return ~crc;
+}
+
+static int otrx_write(int fd, const uint8_t *buf, size_t length) {
+	ssize_t bytes;
+
+	while (length) {
+		bytes = write(fd, buf, length);
+		if (bytes <= 0)
+			return -EIO;
+		buf += bytes;
+		length -= bytes;
+	}
+
+	return 0;
+}
+
+/*
+ * Copies up to length bytes from in (starting at *offset, or at the current
+ * position if offset is NULL) to the current position of out. The kernel
+ * copy_file_range is used if available, otherwise data is read and written.
+ * If crc is passed, data always goes through the buffer and crc is updated.
+ */
+static ssize_t otrx_copy(int in, int64_t *offset, int out, size_t length, uint32_t *crc) {
+	uint8_t buf[OTRX_COPY_BUF_SIZE];
+	size_t copied = 0;
+	ssize_t bytes;
+
+#ifdef __NR_copy_file_range
+	while (!crc && copied < length) {
+		bytes = syscall(__NR_copy_file_range, in, offset, out, NULL, length - copied, 0);
+		if (bytes <= 0)
+			break;
+		copied += bytes;
+	}
+#endif
+
+	while (copied < length) {
+		size_t chunk = length - copied;
+
+		if (chunk > sizeof(buf))
+			chunk = sizeof(buf);
+
+		if (offset)
+			bytes = pread(in, buf, chunk, *offset);
+		else
+			bytes = read(in, buf, chunk);
+		if (bytes < 0)
+			return -EIO;
+		if (!bytes)
+			break;
+
+		if (otrx_write(out, buf, bytes))
+			return -EIO;
+
+		if (crc)
+			*crc = ~otrx_crc32_update(~*crc, buf, bytes);
+		if (offset)
+			*offset += bytes;
+		copied += bytes;
+	}
+
+	return copied;
+}
+
 /**************************************************
  * Check
  **************************************************/
@@ -143,10 +376,11 @@ static void otrx_check_parse_options(int argc, char **argv) {
 }
 
 static int otrx_check(int argc, char **argv) {
-	FILE *trx;
+	int trx;
 	struct trx_header hdr;
-	size_t bytes, length;
-	uint8_t *buf;
+	struct stat st;
+	size_t length, bytes;
+	uint8_t *buf, *map = MAP_FAILED;
 	uint32_t crc32;
 	int err = 0;
 
@@ -160,16 +394,14 @@ static int otrx_check(int argc, char **argv) {
 	optind = 3;
 	otrx_check_parse_options(argc, argv);
 
-	trx = fopen(trx_path, "r");
-	if (!trx) {
+	trx = open(trx_path, O_RDONLY);
+	if (trx < 0) {
 		fprintf(stderr, "Couldn't open %s\n", trx_path);
 		err = -EACCES;
 		goto out;
 	}
 
-	fseek(trx, trx_offset, SEEK_SET);
-	bytes = fread(&hdr, 1, sizeof(hdr), trx);
-	if (bytes != sizeof(hdr)) {
+	if (pread(trx, &hdr, sizeof(hdr), trx_offset) != sizeof(hdr)) {
 		fprintf(stderr, "Couldn't read %s header\n", trx_path);
 		err =  -EIO;
 		goto err_close;
@@ -188,19 +420,38 @@ static int otrx_check(int argc, char **argv) {
 		goto err_close;
 	}
 
-	buf = malloc(length);
-	if (!buf) {
-		fprintf(stderr, "Couldn't alloc %zd B buffer\n", length);
-		err =  -ENOMEM;
-		goto err_close;
+	/* Map regular files, devices (like mtdblock) are read into a buffer */
+	if (!fstat(trx, &st) && S_ISREG(st.st_mode)) {
+		if ((size_t)st.st_size < trx_offset + length) {
+			fprintf(stderr, "Couldn't read %zd B of data from %s\n", length, trx_path);
+			err =  -EIO;
+			goto err_close;
+		}
+		map = mmap(NULL, trx_offset + length, PROT_READ, MAP_SHARED, trx, 0);
 	}
 
-	fseek(trx, trx_offset, SEEK_SET);
-	bytes = fread(buf, 1, length, trx);
-	if (bytes != length) {
-		fprintf(stderr, "Couldn't read %zd B of data from %s\n", length, trx_path);
-		err =  -ENOMEM;
-		goto err_free_buf;
+	if (map != MAP_FAILED) {
+		buf = map + trx_offset;
+	} else {
+		buf = malloc(length);
+		if (!buf) {
+			fprintf(stderr, "Couldn't alloc %zd B buffer\n", length);
+			err =  -ENOMEM;
+			goto err_close;
+		}
+
+		for (bytes = 0; bytes < length; ) {
+			ssize_t n = pread(trx, buf + bytes, length - bytes, trx_offset + bytes);
+
+			if (n <= 0)
+				break;
+			bytes += n;
+		}
+		if (bytes != length) {
+			fprintf(stderr, "Couldn't read %zd B of data from %s\n", length, trx_path);
+			err =  -EIO;
+			goto err_free_buf;
+		}
 	}
 
 	crc32 = otrx_crc32(buf + TRX_FLAGS_OFFSET, length - TRX_FLAGS_OFFSET);
@@ -213,9 +464,12 @@ static int otrx_check(int argc, char **argv) {
 	printf("Found a valid TRX version %d\n", le32_to_cpu(hdr.version));
 
 err_free_buf:
-	free(buf);
+	if (map != MAP_FAILED)
+		munmap(map, trx_offset + length);
+	else
+		free(buf);
 err_close:
-	fclose(trx);
+	close(trx);
 out:
 	return err;
 }
@@ -227,93 +481,83 @@ out:
 static void otrx_create_parse_options(int argc, char **argv) {
 }
 
-static ssize_t otrx_create_append_file(FILE *trx, const char *in_path) {
-	FILE *in;
-	size_t bytes;
-	ssize_t length = 0;
-	uint8_t buf[128];
-
-	in = fopen(in_path, "r");
-	if (!in) {
+/*
+ * The data CRC (crc) is a regular (inverted) CRC32 of everything appended
+ * after the header, it gets combined with the header CRC at the end.
+ */
+static ssize_t otrx_create_append_file(int trx, const char *in_path, uint32_t *crc) {
+	int in;
+	struct stat st;
+	uint8_t *map = MAP_FAILED;
+	ssize_t length;
+
+	in = open(in_path, O_RDONLY);
+	if (in < 0) {
 		fprintf(stderr, "Couldn't open %s\n", in_path);
 		return -EACCES;
 	}
 
-	while ((bytes = fread(buf, 1, sizeof(buf), in)) > 0) {
-		if (fwrite(buf, 1, bytes, trx) != bytes) {
-			fprintf(stderr, "Couldn't write %zu B to %s\n", bytes, trx_path);
+	if (!fstat(in, &st) && S_ISREG(st.st_mode) && st.st_size)
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, in, 0);
+
+	if (map != MAP_FAILED) {
+		length = otrx_copy(in, NULL, trx, st.st_size, NULL);
+		if (length == st.st_size)
+			*crc = otrx_crc32_combine(*crc, ~otrx_crc32(map, length), length);
+		else
 			length = -EIO;
-			break;
-		}
-		length += bytes;
+		munmap(map, st.st_size);
+	} else {
+		length = otrx_copy(in, NULL, trx, SIZE_MAX, crc);
 	}
 
-	fclose(in);
+	if (length < 0)
+		fprintf(stderr, "Couldn't write %s to %s\n", in_path, trx_path);
+
+	close(in);
 
 	return length;
 }
 
-static ssize_t otrx_create_append_zeros(FILE *trx, size_t length) {
-	uint8_t *buf;
-
-	buf = malloc(length);
-	if (!buf)
-		return -ENOMEM;
-	memset(buf, 0, length);
+static ssize_t otrx_create_append_zeros(int trx, size_t length, uint32_t *crc) {
+	static uint8_t buf[4096];
+	size_t bytes, left;
 
-	if (fwrite(buf, 1, length, trx) != length) {
-		fprintf(stderr, "Couldn't write %zu B to %s\n", length, trx_path);
-		return -EIO;
+	for (left = length; left; left -= bytes) {
+		bytes = left < sizeof(buf) ? left : sizeof(buf);
+		if (otrx_write(trx, buf, bytes)) {
+			fprintf(stderr, "Couldn't write %zu B to %s\n", bytes, trx_path);
+			return -EIO;
+		}
+		*crc = ~otrx_crc32_update(~*crc, buf, bytes);
 	}
 
 	return length;
 }
-
-static ssize_t otrx_create_align(FILE *trx, size_t curr_offset, size_t alignment) {
+static ssize_t otrx_create_align(int trx, size_t curr_offset, size_t alignment, uint32_t *crc) {
 	if (curr_offset & (alignment - 1)) {
 		size_t length = alignment - (curr_offset % alignment);
-		return otrx_create_append_zeros(trx, length);
+		return otrx_create_append_zeros(trx, length, crc);
 	}
 
 	return 0;
 }
 
-static int otrx_create_write_hdr(FILE *trx, struct trx_header *hdr) {
-	size_t bytes, length;
-	uint8_t *buf;
+static int otrx_create_write_hdr(int trx, struct trx_header *hdr, uint32_t data_crc) {
+	size_t length;
 	uint32_t crc32;
 
 	hdr->magic = cpu_to_le32(TRX_MAGIC);
-	hdr->version = 1;
-
-	fseek(trx, 0, SEEK_SET);
-	bytes = fwrite(hdr, 1, sizeof(struct trx_header), trx);
-	if (bytes != sizeof(struct trx_header)) {
-		fprintf(stderr, "Couldn't write TRX header to %s\n", trx_path);
-		return -EIO;
-	}
+	hdr->version = cpu_to_le32(1);
 
 	length = le32_to_cpu(hdr->length);
 
-	buf = malloc(length);
-	if (!buf) {
-		fprintf(stderr, "Couldn't alloc %zu B buffer\n", length);
-		return -ENOMEM;
-	}
+	/* TRX CRC covers header fields following it, prepend them to the data */
+	crc32 = ~otrx_crc32_update(0xffffffff, (uint8_t *)hdr + TRX_FLAGS_OFFSET, sizeof(*hdr) - TRX_FLAGS_OFFSET);
+	crc32 = otrx_crc32_combine(crc32, data_crc, length - sizeof(*hdr));
+	hdr->crc32 = cpu_to_le32(~crc32);
 
-	fseek(trx, 0, SEEK_SET);
-	bytes = fread(buf, 1, length, trx);
-	if (bytes != length) {
-		fprintf(stderr, "Couldn't read %zu B of data from %s\n", length, trx_path);
-		return -ENOMEM;
-	}
-
-	crc32 = otrx_crc32(buf + TRX_FLAGS_OFFSET, length - TRX_FLAGS_OFFSET);
-	hdr->crc32 = cpu_to_le32(crc32);
-
-	fseek(trx, 0, SEEK_SET);
-	bytes = fwrite(hdr, 1, sizeof(struct trx_header), trx);
-	if (bytes != sizeof(struct trx_header)) {
+	if (pwrite(trx, hdr, sizeof(*hdr), 0) != sizeof(*hdr)) {
 		fprintf(stderr, "Couldn't write TRX header to %s\n", trx_path);
 		return -EIO;
 	}
@@ -322,8 +566,9 @@ static int otrx_create_write_hdr(FILE *trx, struct trx_header *hdr) {
 }
 
 static int otrx_create(int argc, char **argv) {
-	FILE *trx;
+	int trx;
 	struct trx_header hdr = {};
+	uint32_t crc = 0;
 	ssize_t sbytes;
 	size_t curr_idx = 0;
 	size_t curr_offset = sizeof(hdr);
@@ -340,13 +585,13 @@ static int otrx_create(int argc, char **argv) {
 	optind = 3;
 	otrx_create_parse_options(argc, argv);
 
-	trx = fopen(trx_path, "w+");
-	if (!trx) {
+	trx = open(trx_path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (trx < 0) {
 		fprintf(stderr, "Couldn't open %s\n", trx_path);
 		err = -EACCES;
 		goto out;
 	}
-	fseek(trx, curr_offset, SEEK_SET);
+	lseek(trx, curr_offset, SEEK_SET);
 
 	optind = 3;
 	while ((c = getopt(argc, argv, "f:b:")) != -1) {
@@ -358,15 +603,15 @@ static int otrx_create(int argc, char **argv) {
 				goto err_close;
 			}
 
-			sbytes = otrx_create_append_file(trx, optarg);
+			sbytes = otrx_create_append_file(trx, optarg, &crc);
 			if (sbytes < 0) {
 				fprintf(stderr, "Failed to append file %s\n", optarg);
 			} else {
-				hdr.offset[curr_idx++] = curr_offset;
+				hdr.offset[curr_idx++] = cpu_to_le32(curr_offset);
 				curr_offset += sbytes;
 			}
 
-			sbytes = otrx_create_align(trx, curr_offset, 4);
+			sbytes = otrx_create_align(trx, curr_offset, 4, &crc);
 			if (sbytes < 0)
 				fprintf(stderr, "Failed to append zeros\n");
 			else
@@ -378,7 +623,7 @@ static int otrx_create(int argc, char **argv) {
 			if (sbytes < 0) {
 				fprintf(stderr, "Current TRX length is 0x%zx, can't pad it with zeros to 0x%lx\n", curr_offset, strtol(optarg, NULL, 0));
 			} else {
-				sbytes = otrx_create_append_zeros(trx, sbytes);
+				sbytes = otrx_create_append_zeros(trx, sbytes, &crc);
 				if (sbytes < 0)
 					fprintf(stderr, "Failed to append zeros\n");
 				else
@@ -390,10 +635,10 @@ static int otrx_create(int argc, char **argv) {
 			break;
 	}
 
-	hdr.length = curr_offset;
-	otrx_create_write_hdr(trx, &hdr);
+	hdr.length = cpu_to_le32(curr_offset);
+	otrx_create_write_hdr(trx, &hdr, crc);
 err_close:
-	fclose(trx);
+	close(trx);
 out:
 	return err;
 }
@@ -423,55 +668,37 @@ static void otrx_extract_parse_options(int argc, char **argv) {
 	}
 }
 
-static int otrx_extract_copy(FILE *trx, size_t offset, size_t length, char *out_path) {
-	FILE *out;
-	size_t bytes;
-	uint8_t *buf;
+static int otrx_extract_copy(int trx, size_t offset, size_t length, char *out_path) {
+	int out;
+	int64_t pos = offset;
+	ssize_t bytes;
 	int err = 0;
 
-	out = fopen(out_path, "w");
-	if (!out) {
+	out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out < 0) {
 		fprintf(stderr, "Couldn't open %s\n", out_path);
 		err = -EACCES;
 		goto out;
 	}
 
-	buf = malloc(length);
-	if (!buf) {
-		fprintf(stderr, "Couldn't alloc %zu B buffer\n", length);
-		err =  -ENOMEM;
-		goto err_close;
-	}
-
-	fseek(trx, offset, SEEK_SET);
-	bytes = fread(buf, 1, length, trx);
-	if (bytes != length) {
-		fprintf(stderr, "Couldn't read %zu B of data from %s\n", length, trx_path);
-		err =  -ENOMEM;
-		goto err_free_buf;
-	};
-
-	bytes = fwrite(buf, 1, length, out);
+	bytes = otrx_copy(trx, &pos, out, length, NULL);
 	if (bytes != length) {
-		fprintf(stderr, "Couldn't write %zu B to %s\n", length, out_path);
-		err =  -ENOMEM;
-		goto err_free_buf;
+		fprintf(stderr, "Couldn't copy %zu B of data from %s to %s\n", length, trx_path, out_path);
+		err =  -EIO;
+		goto err_close;
 	}
 
 	printf("Extracted 0x%zx bytes into %s\n", length, out_path);
 
-err_free_buf:
-	free(buf);
 err_close:
-	fclose(out);
+	close(out);
 out:
 	return err;
 }
 
 static int otrx_extract(int argc, char **argv) {
-	FILE *trx;
+	int trx;
 	struct trx_header hdr;
-	size_t bytes;
 	int i;
 	int err = 0;
 
@@ -485,16 +712,14 @@ static int otrx_extract(int argc, char **argv) {
 	optind = 3;
 	otrx_extract_parse_options(argc, argv);
 
-	trx = fopen(trx_path, "r");
-	if (!trx) {
+	trx = open(trx_path, O_RDONLY);
+	if (trx < 0) {
 		fprintf(stderr, "Couldn't open %s\n", trx_path);
 		err = -EACCES;
 		goto out;
 	}
 
-	fseek(trx, trx_offset, SEEK_SET);
-	bytes = fread(&hdr, 1, sizeof(hdr), trx);
-	if (bytes != sizeof(hdr)) {
+	if (pread(trx, &hdr, sizeof(hdr), trx_offset) != sizeof(hdr)) {
 		fprintf(stderr, "Couldn't read %s header\n", trx_path);
 		err =  -EIO;
 		goto err_close;
@@ -525,7 +750,7 @@ static int otrx_extract(int argc, char **argv) {
 	}
 
 err_close:
-	fclose(trx);
+	close(trx);
 out:
 	return err;
 }
@@ -38,6 +38,8 @@ enum input_mode {
 
 static int indent = 1;
 static int tty_stdio;
+static int print_stats;
+static struct timeval stats_time;
 static int valid_stdin = 1;
 static int sync_kconfig;
 static int conf_cnt;
@@ -488,6 +490,24 @@ static void conf_usage(const char *progname)
 	printf("  --randconfig            New config with random answer to all options\n");
 }
 
+/*
+ * With KCONFIG_STATS set, report the time spent in each phase and the
+ * symbol recalculation counters on stderr.
+ */
+static void conf_stats_phase(const char *phase)
+{
+	struct timeval now;
+
+	if (!print_stats)
+		return;
+	gettimeofday(&now, NULL);
+	if (phase)
+		fprintf(stderr, "kconfig: %-8s %9.3f ms\n", phase,
+			(now.tv_sec - stats_time.tv_sec) * 1000.0 +
+			(now.tv_usec - stats_time.tv_usec) / 1000.0);
+	stats_time = now;
+}
+
 int main(int ac, char **av)
 {
 	const char *progname = av[0];
@@ -563,8 +583,11 @@ int main(int ac, char **av)
 		conf_usage(progname);
 		exit(1);
 	}
+	print_stats = getenv("KCONFIG_STATS") != NULL;
+	conf_stats_phase(NULL);
 	name = av[optind];
 	conf_parse(name);
+	conf_stats_phase("parse");
 	//zconfdump(stdout);
 	if (sync_kconfig) {
 		name = conf_get_configname();
@@ -606,6 +629,7 @@ int main(int ac, char **av)
 	default:
 		break;
 	}
+	conf_stats_phase("read");
 
 	if (sync_kconfig) {
 		if (conf_get_changed()) {
@@ -659,6 +683,7 @@ int main(int ac, char **av)
 			  input_mode != olddefconfig));
 		break;
 	}
+	conf_stats_phase("process");
 
 	if (sync_kconfig) {
 		/* silentoldconfig is used during the build so we shall update autoconf.
@@ -685,6 +710,9 @@ int main(int ac, char **av)
 			exit(1);
 		}
 	}
+	conf_stats_phase("write");
+	if (print_stats)
+		sym_print_stats(stderr);
 	return 0;
 }
 
@@ -126,6 +126,7 @@ struct file *file_lookup(const char *name);
 int file_write_dep(const char *name);
 void *xmalloc(size_t size);
 void *xcalloc(size_t nmemb, size_t size);
+void *xrealloc(void *p, size_t size);
 
 struct gstr {
 	size_t len;
@@ -146,7 +147,17 @@ const char *str_get(struct gstr *gs);
 /* symbol.c */
 extern struct expr *sym_env_list;
 
+struct sym_stats {
+	unsigned long changes;		/* incremental invalidations */
+	unsigned long full_clears;	/* calls to sym_clear_all_valid() */
+	unsigned long invalidated;	/* symbols invalidated incrementally */
+	unsigned long recalcs;		/* values computed by sym_calc_value() */
+};
+extern struct sym_stats sym_stats;
+
 void sym_init(void);
+void sym_build_rdeps(void);
+void sym_print_stats(FILE *out);
 void sym_clear_all_valid(void);
 void sym_set_all_changed(void);
 void sym_set_changed(struct symbol *sym);
@@ -1038,5 +1038,8 @@ int main(int ac, char **av)
 		res = handle_exit();
 	} while (res == KEY_ESC);
 
+	if (getenv("KCONFIG_STATS"))
+		sym_print_stats(stderr);
+
 	return res;
 }
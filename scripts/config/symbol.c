@@ -32,6 +32,7 @@ struct symbol symbol_yes = {
 struct symbol *sym_defconfig_list;
 struct symbol *modules_sym;
 tristate modules_val;
+struct sym_stats sym_stats;
 
 struct expr *sym_env_list;
 
@@ -310,6 +311,7 @@ void sym_calc_value(struct symbol *sym)
 	}
 
 	sym->flags |= SYMBOL_VALID;
+	sym_stats.recalcs++;
 
 	oldval = sym->curr;
 
@@ -446,11 +448,140 @@ void sym_clear_all_valid(void)
 
 	for_all_symbols(i, sym)
 		sym->flags &= ~SYMBOL_VALID;
+	sym_stats.full_clears++;
 	sym_add_change_count(1);
 	if (modules_sym)
 		sym_calc_value(modules_sym);
 }
 
+static bool sym_rdeps_valid;
+static unsigned int sym_rdep_stamp;
+
+static void sym_add_rdep(struct symbol *dep, struct symbol *sym)
+{
+	int n = dep->rdep_count;
+
+	if (dep == sym || dep->flags & SYMBOL_CONST)
+		return;
+	/* all edges of sym are added in one go, so a dup is always last */
+	if (n && dep->rdeps[n - 1] == sym)
+		return;
+	/* grow in powers of two */
+	if (!(n & (n - 1)))
+		dep->rdeps = xrealloc(dep->rdeps,
+				      (n ? 2 * n : 1) * sizeof(*dep->rdeps));
+	dep->rdeps[n] = sym;
+	dep->rdep_count = n + 1;
+}
+
+static void sym_add_expr_rdeps(struct expr *e, struct symbol *sym)
+{
+	if (!e)
+		return;
+	switch (e->type) {
+	case E_OR:
+	case E_AND:
+		sym_add_expr_rdeps(e->left.expr, sym);
+		sym_add_expr_rdeps(e->right.expr, sym);
+		break;
+	case E_NOT:
+		sym_add_expr_rdeps(e->left.expr, sym);
+		break;
+	case E_LIST:
+		sym_add_expr_rdeps(e->left.expr, sym);
+		sym_add_rdep(e->right.sym, sym);
+		break;
+	case E_EQUAL:
+	case E_UNEQUAL:
+	case E_RANGE:
+		sym_add_rdep(e->left.sym, sym);
+		sym_add_rdep(e->right.sym, sym);
+		break;
+	case E_SYMBOL:
+		sym_add_rdep(e->left.sym, sym);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Build the reverse dependency graph: for every symbol, the list of
+ * symbols whose value is calculated from it. Choice symbols and their
+ * values reference each other through their P_CHOICE properties.
+ * Must be called after menu_finalize() has propagated all dependencies.
+ */
+void sym_build_rdeps(void)
+{
+	struct symbol *sym;
+	struct property *prop;
+	int i;
+
+	for_all_symbols(i, sym) {
+		sym_add_expr_rdeps(sym->dir_dep.expr, sym);
+		sym_add_expr_rdeps(sym->rev_dep.expr, sym);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			/* the expression of a select is the selected symbol */
+			if (prop->type == P_SELECT)
+				continue;
+			sym_add_expr_rdeps(prop->visible.expr, sym);
+			sym_add_expr_rdeps(prop->expr, sym);
+		}
+	}
+	sym_rdeps_valid = true;
+}
+
+/* returns true if the invalidation reached the modules symbol */
+static bool sym_invalidate_rdeps(struct symbol *sym)
+{
+	int i;
+
+	if (sym->rdep_stamp == sym_rdep_stamp)
+		return false;
+	sym->rdep_stamp = sym_rdep_stamp;
+	if (sym == modules_sym)
+		return true;
+
+	sym->flags &= ~SYMBOL_VALID;
+	sym_stats.invalidated++;
+	for (i = 0; i < sym->rdep_count; i++)
+		if (sym_invalidate_rdeps(sym->rdeps[i]))
+			return true;
+	return false;
+}
+
+void sym_print_stats(FILE *out)
+{
+	fprintf(out, "kconfig: %lu full recalcs, %lu incremental changes "
+		"(%lu symbols invalidated, %.1f per change), "
+		"%lu symbol values calculated\n",
+		sym_stats.full_clears, sym_stats.changes,
+		sym_stats.invalidated,
+		sym_stats.changes ?
+			(double)sym_stats.invalidated / sym_stats.changes : 0.0,
+		sym_stats.recalcs);
+}
+
+/*
+ * Invalidate sym and everything that transitively depends on it.
+ * A change of the modules symbol alters the effective type of every
+ * tristate symbol, so that still invalidates all symbols.
+ */
+static void sym_clear_dependents_valid(struct symbol *sym)
+{
+	if (!sym_rdeps_valid) {
+		sym_clear_all_valid();
+		return;
+	}
+	sym_rdep_stamp++;
+	if (sym_invalidate_rdeps(sym)) {
+		sym_clear_all_valid();
+		return;
+	}
+	sym_stats.changes++;
+	sym_add_change_count(1);
+}
+
 void sym_set_changed(struct symbol *sym)
 {
 	struct property *prop;
@@ -521,7 +652,7 @@ bool sym_set_tristate_value(struct symbol *sym, tristate val)
 
 	sym->def[S_DEF_USER].tri = val;
 	if (oldval != val)
-		sym_clear_all_valid();
+		sym_clear_dependents_valid(sym);
 
 	return true;
 }
@@ -678,7 +809,7 @@ bool sym_set_string_value(struct symbol *sym, const char *newval)
 
 	strcpy(val, newval);
 	free((void *)oldval);
-	sym_clear_all_valid();
+	sym_clear_dependents_valid(sym);
 
 	return true;
 }
@@ -525,6 +525,7 @@ void conf_parse(const char *name)
 	}
 	if (zconfnerrs)
 		exit(1);
+	sym_build_rdeps();
 	sym_set_change_count(1);
 }
 
@@ -10,6 +10,9 @@ use strict;
 use warnings;
 use File::Basename;
 use File::Copy;
+use Digest::MD5;
+use Fcntl qw(:flock);
+use Time::HiRes qw(time);
 
 @ARGV > 2 or die "Syntax: $0 <target dir> <filename> <md5sum> [<mirror> ...]\n";
 
@@ -18,8 +21,18 @@ my $filename = shift @ARGV;
 my $md5sum = shift @ARGV;
 my $scriptdir = dirname($0);
 my @mirrors;
+my @local_mirrors;
 my $ok;
 
+# number of mirrors raced against each other for a single file
+my $race = $ENV{DOWNLOAD_RACE} || 2;
+
+# per host throughput and failure statistics, shared by all downloads
+my $statsfile = "$target/.mirror-stats";
+my %stats;
+my %results;
+my %running;
+
 sub localmirrors {
 	my @mlist;
 	open LM, "$scriptdir/localmirrors" and do {
@@ -46,107 +59,217 @@ sub localmirrors {
 	return @mlist;
 }
 
-sub which($) {
-	my $prog = shift;
-	my $res = `which $prog`;
-	$res or return undef;
-	$res =~ /^no / and return undef;
-	$res =~ /not found/ and return undef;
-	return $res;
+sub md5_file($) {
+	my $file = shift;
+	my $md5 = Digest::MD5->new;
+
+	open my $fh, "<", $file or return "";
+	binmode $fh;
+	$md5->addfile($fh);
+	close $fh;
+	return $md5->hexdigest;
 }
 
-my $md5cmd = which("md5sum") || which("md5") || die 'no md5 checksum program found, please install md5 or md5sum';
-chomp $md5cmd;
+sub md5_ok($) {
+	my $sum = shift;
 
-sub download
-{
+	if (($md5sum =~ /\w{32}/) and ($sum ne $md5sum)) {
+		print STDERR "MD5 sum of the downloaded file does not match (file: $sum, requested: $md5sum) - deleting download.\n";
+		return 0;
+	}
+	return 1;
+}
+
+sub mirror_host($) {
 	my $mirror = shift;
-	my $options = $ENV{WGET_OPTIONS} || "";
 
-	$mirror =~ s!/$!!;
+	$mirror =~ m!^(\w+://[^/]+)! and return $1;
+	return $mirror;
+}
 
-	if ($mirror =~ s!^file://!!) {
-		if (! -d "$mirror") {
-			print STDERR "Wrong local cache directory -$mirror-.\n";
-			cleanup();
-			return;
-		}
+sub read_stats($) {
+	my $fh = shift;
+	my %s;
 
-		if (! -d "$target") {
-			system("mkdir", "-p", "$target/");
-		}
+	while (<$fh>) {
+		chomp;
+		my ($host, $rate, $failures) = split /\t/;
+		defined $failures or next;
+		$s{$host} = [ $rate, $failures ];
+	}
+	return %s;
+}
 
-		if (! open TMPDLS, "find $mirror -follow -name $filename 2>/dev/null |") {
-			print("Failed to search for $filename in $mirror\n");
-			return;
-		}
+sub load_stats {
+	open my $fh, "<", $statsfile or return;
+	%stats = read_stats($fh);
+	close $fh;
+}
 
-		my $link;
+# merge the results of this run, other downloads may update the file concurrently
+sub save_stats {
+	%results or return;
+	-d $target or return;
+	open my $fh, "+>>", $statsfile or return;
+	flock $fh, LOCK_EX or return;
+	seek $fh, 0, 0;
+	my %s = read_stats($fh);
+	foreach my $host (keys %results) {
+		my ($rate, $failures) = @{$s{$host} || [ 0, 0 ]};
+		my $new = $results{$host};
 
-		while (defined(my $line = readline TMPDLS)) {
-			chomp ($link = $line);
-			if ($. > 1) {
-				print("$. or more instances of $filename in $mirror found . Only one instance allowed.\n");
-				return;
-			}
+		if (defined $new) {
+			$rate = $rate ? int(($rate * 3 + $new) / 4) : int($new);
+			$failures = 0;
+		} else {
+			$failures++;
 		}
+		$s{$host} = [ $rate, $failures ];
+	}
+	seek $fh, 0, 0;
+	truncate $fh, 0;
+	foreach my $host (sort keys %s) {
+		print $fh join("\t", $host, @{$s{$host}})."\n";
+	}
+	close $fh;
+	%results = ();
+}
 
-		close TMPDLS;
+# Hosts that failed repeatedly go last, hosts with known throughput are
+# tried fastest first, unknown hosts keep their original order in between,
+# followed by hosts that only ever failed.
+sub rank_mirrors(@) {
+	my @list = @_;
+	my @key = map {
+		my $s = $stats{mirror_host($_)};
+		!$s ? [ 1, 0 ] :
+		$s->[1] >= 3 ? [ 2, 0 ] :
+		!$s->[0] ? [ 1.5, 0 ] :
+		[ 0, $s->[0] ];
+	} @list;
 
-		if (! $link) {
-			print("No instances of $filename found in $mirror.\n");
-			return;
-		}
+	return map { $list[$_] } sort {
+		$key[$a]->[0] <=> $key[$b]->[0] or
+		$key[$b]->[1] <=> $key[$a]->[1] or
+		$a <=> $b
+	} 0 .. $#list;
+}
 
-		print("Copying $filename from $link\n");
-		copy($link, "$target/$filename.dl");
+sub finish($) {
+	my $file = shift;
 
-		if (system("$md5cmd '$target/$filename.dl' > '$target/$filename.md5sum'")) {
-			print("Failed to generate md5 sum for $filename\n");
-			return;
-		}
-	} else {
-		open WGET, "wget -t5 --timeout=20 --no-check-certificate $options -O- '$mirror/$filename' |" or die "Cannot launch wget.\n";
-		open MD5SUM, "| $md5cmd > '$target/$filename.md5sum'" or die "Cannot launch md5sum.\n";
-		open OUTPUT, "> $target/$filename.dl" or die "Cannot create file $target/$filename.dl: $!\n";
-		my $buffer;
-		while (read WGET, $buffer, 1048576) {
-			print MD5SUM $buffer;
-			print OUTPUT $buffer;
-		}
-		close MD5SUM;
-		close WGET;
-		close OUTPUT;
+	unlink "$target/$filename";
+	rename $file, "$target/$filename";
+}
+
+sub download_local
+{
+	my $mirror = shift;
+
+	$mirror =~ s!/$!!;
+	$mirror =~ s!^file://!!;
+
+	if (! -d "$mirror") {
+		print STDERR "Wrong local cache directory -$mirror-.\n";
+		return;
+	}
+
+	if (! -d "$target") {
+		system("mkdir", "-p", "$target/");
+	}
 
-		if ($? >> 8) {
-			print STDERR "Download failed.\n";
-			cleanup();
+	if (! open TMPDLS, "find $mirror -follow -name $filename 2>/dev/null |") {
+		print("Failed to search for $filename in $mirror\n");
+		return;
+	}
+
+	my $link;
+
+	while (defined(my $line = readline TMPDLS)) {
+		chomp ($link = $line);
+		if ($. > 1) {
+			print("$. or more instances of $filename in $mirror found . Only one instance allowed.\n");
 			return;
 		}
 	}
 
-	my $sum = `cat "$target/$filename.md5sum"`;
-	$sum =~ /^(\w+)\s*/ or die "Could not generate md5sum\n";
-	$sum = $1;
+	close TMPDLS;
 
-	if (($md5sum =~ /\w{32}/) and ($sum ne $md5sum)) {
-		print STDERR "MD5 sum of the downloaded file does not match (file: $sum, requested: $md5sum) - deleting download.\n";
-		cleanup();
+	if (! $link) {
+		print("No instances of $filename found in $mirror.\n");
 		return;
 	}
 
-	unlink "$target/$filename";
-	system("mv", "$target/$filename.dl", "$target/$filename");
-	cleanup();
+	print("Copying $filename from $link\n");
+	copy($link, "$target/$filename.dl");
+
+	if (md5_ok(md5_file("$target/$filename.dl"))) {
+		finish("$target/$filename.dl");
+	}
+	unlink "$target/$filename.dl";
+}
+
+# runs in a child process, the md5 sum is calculated while streaming
+sub download_remote($$)
+{
+	my $mirror = shift;
+	my $file = shift;
+	my $options = $ENV{WGET_OPTIONS} || "";
+	my $md5 = Digest::MD5->new;
+	my $buffer;
+
+	open WGET, "wget -t5 --timeout=20 --no-check-certificate $options -O- '$mirror/$filename' |" or die "Cannot launch wget.\n";
+	open OUTPUT, "> $file" or die "Cannot create file $file: $!\n";
+	while (read WGET, $buffer, 1048576) {
+		$md5->add($buffer);
+		print OUTPUT $buffer;
+	}
+	close WGET;
+	my $failed = $? >> 8;
+	close OUTPUT;
+
+	if ($failed) {
+		print STDERR "Download from $mirror failed.\n";
+		return 1;
+	}
+	return md5_ok($md5->hexdigest) ? 0 : 1;
+}
+
+sub start_download($) {
+	my $mirror = shift;
+	my $file = "$target/$filename.dl";
+	my $n = 0;
+
+	$mirror =~ s!/$!!;
+	system("mkdir", "-p", "$target/") unless -d $target;
+	$file = "$target/$filename.dl".++$n while -e $file or grep { $_->{file} eq $file } values %running;
+
+	my $pid = fork();
+	defined $pid or die "Cannot fork: $!\n";
+	if ($pid == 0) {
+		# own process group, so that losing downloads can be killed with wget
+		setpgrp(0, 0);
+		$SIG{INT} = $SIG{TERM} = 'DEFAULT';
+		exit download_remote($mirror, $file);
+	}
+	$running{$pid} = {
+		mirror => $mirror,
+		file => $file,
+		start => time
+	};
 }
 
 sub cleanup
 {
-	unlink "$target/$filename.dl";
-	unlink "$target/$filename.md5sum";
+	foreach my $pid (keys %running) {
+		kill 'TERM', -$pid;
+		waitpid $pid, 0;
+		unlink $running{$pid}->{file};
+	}
+	%running = ();
 }
 
-@mirrors = localmirrors();
+@local_mirrors = localmirrors();
 
 foreach my $mirror (@ARGV) {
 	if ($mirror =~ /^\@SF\/(.+)$/) {
@@ -199,13 +322,39 @@ foreach my $mirror (@ARGV) {
 push @mirrors, 'http://mirror2.openwrt.org/sources';
 push @mirrors, 'http://downloads.openwrt.org/sources';
 
-while (!$ok) {
-	my $mirror = shift @mirrors;
-	$mirror or die "No more mirrors to try - giving up.\n";
+$SIG{INT} = $SIG{TERM} = sub { cleanup(); exit 1; };
 
-	download($mirror);
-	-f "$target/$filename" and $ok = 1;
+load_stats();
+@mirrors = ((grep { !/^file:\/\// } @local_mirrors), rank_mirrors(@mirrors));
+
+foreach my $mirror (grep { /^file:\/\// } @local_mirrors) {
+	download_local($mirror);
+	-f "$target/$filename" and exit 0;
 }
 
-$SIG{INT} = \&cleanup;
+# keep up to $race downloads running, the first one to complete wins
+while (!$ok) {
+	while (@mirrors and keys(%running) < $race) {
+		start_download(shift @mirrors);
+	}
+	if (!%running) {
+		save_stats();
+		die "No more mirrors to try - giving up.\n";
+	}
+
+	my $pid = wait();
+	my $dl = delete $running{$pid} or next;
+	my $host = mirror_host($dl->{mirror});
+
+	if ($? == 0) {
+		cleanup();
+		finish($dl->{file});
+		$results{$host} = (-s "$target/$filename") / (time - $dl->{start} || 1);
+		$ok = 1;
+	} else {
+		unlink $dl->{file};
+		$results{$host} = undef;
+	}
+}
 
+save_stats();
@@ -3,8 +3,31 @@ use FindBin;
 use lib "$FindBin::Bin";
 use strict;
 use metadata;
+use Time::HiRes qw(time);
 
 my %board;
+my $timing = $ENV{METADATA_TIMING};
+my $phase_start = time;
+
+# print the time spent since the previous phase if METADATA_TIMING is set
+sub phase_time($) {
+	my $phase = shift;
+	my $now = time;
+
+	$timing and printf STDERR "metadata: %-16s %9.3f ms\n", $phase, ($now - $phase_start) * 1000;
+	$phase_start = $now;
+}
+
+my $package_metadata_file;
+sub load_package_metadata($) {
+	my $file = shift;
+
+	return 1 if defined($package_metadata_file) and $package_metadata_file eq $file;
+	parse_package_metadata($file) or return undef;
+	$package_metadata_file = $file;
+	phase_time("parse");
+	return 1;
+}
 
 sub version_to_num($) {
 	my $str = shift;
@@ -383,13 +406,17 @@ sub __find_package_dep($$) {
 	return 0;
 }
 
-# wrapper to avoid infinite recursion
+# wrapper to avoid infinite recursion, results are cached since the
+# package sort asks for the same pairs many times
+my %dep_cache;
 sub find_package_dep($$) {
 	my $pkg = shift;
 	my $name = shift;
+	my $key = "$pkg->{name}:$name";
 
+	exists $dep_cache{$key} and return $dep_cache{$key};
 	%dep_check = ();
-	return __find_package_dep($pkg, $name);
+	return $dep_cache{$key} = __find_package_dep($pkg, $name);
 }
 
 sub package_depends($$) {
@@ -608,7 +635,7 @@ sub print_package_overrides() {
 }
 
 sub gen_package_config() {
-	parse_package_metadata($ARGV[0]) or exit 1;
+	load_package_metadata($ARGV[0]) or exit 1;
 	print "menuconfig IMAGEOPT\n\tbool \"Image configuration\"\n\tdefault n\n";
 	foreach my $preconfig (keys %preconfig) {
 		foreach my $cfg (keys %{$preconfig{$preconfig}}) {
@@ -655,7 +682,7 @@ sub gen_package_mk() {
 	my %done;
 	my $line;
 
-	parse_package_metadata($ARGV[0]) or exit 1;
+	load_package_metadata($ARGV[0]) or exit 1;
 	foreach my $name (sort {uc($a) cmp uc($b)} keys %package) {
 		my $config;
 		my $pkg = $package{$name};
@@ -822,7 +849,7 @@ EOF
 }
 
 sub gen_package_source() {
-	parse_package_metadata($ARGV[0]) or exit 1;
+	load_package_metadata($ARGV[0]) or exit 1;
 	foreach my $name (sort {uc($a) cmp uc($b)} keys %package) {
 		my $pkg = $package{$name};
 		if ($pkg->{name} && $pkg->{source}) {
@@ -833,7 +860,7 @@ sub gen_package_source() {
 }
 
 sub gen_package_feeds() {
-	parse_package_metadata($ARGV[0]) or exit 1;
+	load_package_metadata($ARGV[0]) or exit 1;
 	foreach my $name (sort {uc($a) cmp uc($b)} keys %package) {
 		my $pkg = $package{$name};
 		if ($pkg->{name} && $pkg->{feed}) {
@@ -844,7 +871,7 @@ sub gen_package_feeds() {
 
 sub gen_package_license($) {
 	my $level = shift;
-	parse_package_metadata($ARGV[0]) or exit 1;
+	load_package_metadata($ARGV[0]) or exit 1;
 	foreach my $name (sort {uc($a) cmp uc($b)} keys %package) {
 		my $pkg = $package{$name};
 		if ($pkg->{name}) {
@@ -864,6 +891,44 @@ sub gen_package_license($) {
 	}
 }
 
+# Parse the package metadata once and generate several outputs from it in
+# parallel, arguments are <command>=<output file> pairs
+sub gen_package_multi() {
+	my $file = shift @ARGV;
+	my %gen = (
+		package_config => \&gen_package_config,
+		package_mk => \&gen_package_mk,
+		package_source => \&gen_package_source,
+		package_feeds => \&gen_package_feeds,
+	);
+	my %output;
+	my $ret = 0;
+
+	load_package_metadata($file) or exit 1;
+	foreach my $arg (@ARGV) {
+		my ($cmd, $out) = split /=/, $arg, 2;
+		($gen{$cmd} and $out) or die "Invalid output '$arg'\n";
+
+		my $pid = fork();
+		defined $pid or die "Cannot fork: $!\n";
+		if ($pid == 0) {
+			open STDOUT, ">", $out or die "Cannot open '$out': $!\n";
+			@ARGV = ($file);
+			$gen{$cmd}->();
+			close STDOUT or exit 1;
+			phase_time($cmd);
+			exit 0;
+		}
+		$output{$pid} = $out;
+	}
+	while ((my $pid = wait()) > 0) {
+		next if $? == 0;
+		unlink $output{$pid};
+		$ret = 1;
+	}
+	exit $ret;
+}
+
 sub gen_version_filtered_list() {
 	foreach my $item (version_filter_list(@ARGV)) {
 		print "$item\n";
@@ -879,6 +944,7 @@ sub parse_command() {
 		/^kconfig/ and return gen_kconfig_overrides();
 		/^package_source$/ and return gen_package_source();
 		/^package_feeds$/ and return gen_package_feeds();
+		/^package_multi$/ and return gen_package_multi();
 		/^package_license$/ and return gen_package_license(0);
 		/^package_licensefull$/ and return gen_package_license(1);
 		/^version_filter$/ and return gen_version_filtered_list();
@@ -891,6 +957,7 @@ Available Commands:
 	$0 kconfig [file] [config] [patchver]	Kernel config overrides
 	$0 package_source [file] 		Package source file information
 	$0 package_feeds [file]			Package feed information in makefile format
+	$0 package_multi [file] [cmd=out...]	Generate several package outputs from one parse
 	$0 package_license [file] 		Package license information
 	$0 package_licensefull [file] 		Package license information (full list)
 	$0 version_filter [patchver] [list...]	Filter list of version tagged strings
@@ -899,3 +966,4 @@ EOF
 }
 
 parse_command();
+phase_time("generate");
@@ -30,6 +30,7 @@
 #include <linux/skbuff.h>
 #include <linux/dma-mapping.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 
 #include <linux/bitops.h>
 
@@ -43,6 +44,9 @@
 #define AG71XX_NAPI_WEIGHT	64
 #define AG71XX_OOM_REFILL	(1 + HZ/10)
 
+#define AG71XX_COALESCE_MAX_USECS	1000
+#define AG71XX_COALESCE_MIN_USECS	10
+
 #define AG71XX_INT_ERR	(AG71XX_INT_RX_BE | AG71XX_INT_TX_BE)
 #define AG71XX_INT_TX	(AG71XX_INT_TX_PS)
 #define AG71XX_INT_RX	(AG71XX_INT_RX_PR | AG71XX_INT_RX_OF)
@@ -122,6 +126,7 @@ struct ag71xx_int_stats {
 	unsigned long		tx_ps;
 	unsigned long		tx_be;
 	unsigned long		tx_ur;
+	unsigned long		timer;
 	unsigned long		total;
 };
 
@@ -176,6 +181,11 @@ struct ag71xx {
 	struct delayed_work	link_work;
 	struct timer_list	oom_timer;
 
+	struct hrtimer		coalesce_timer;
+	unsigned int		coalesce_usecs;
+	unsigned int		coalesce_cur_usecs;
+	bool			coalesce_adaptive;
+
 #ifdef CONFIG_AG71XX_DEBUG_FS
 	struct ag71xx_debug	debug;
 #endif
@@ -458,6 +468,11 @@ int ag71xx_debugfs_init(struct ag71xx *ag);
 void ag71xx_debugfs_exit(struct ag71xx *ag);
 void ag71xx_debugfs_update_int_stats(struct ag71xx *ag, u32 status);
 void ag71xx_debugfs_update_napi_stats(struct ag71xx *ag, int rx, int tx);
+
+static inline void ag71xx_debugfs_update_timer_stats(struct ag71xx *ag)
+{
+	ag->debug.int_stats.timer++;
+}
 #else
 static inline int ag71xx_debugfs_root_init(void) { return 0; }
 static inline void ag71xx_debugfs_root_exit(void) {}
@@ -467,6 +482,7 @@ static inline void ag71xx_debugfs_update_int_stats(struct ag71xx *ag,
 						   u32 status) {}
 static inline void ag71xx_debugfs_update_napi_stats(struct ag71xx *ag,
 						    int rx, int tx) {}
+static inline void ag71xx_debugfs_update_timer_stats(struct ag71xx *ag) {}
 #endif /* CONFIG_AG71XX_DEBUG_FS */
 
 void ag71xx_ar7240_start(struct ag71xx *ag);
@@ -49,7 +49,11 @@ static ssize_t read_file_int_stats(struct file *file, char __user *user_buf,
 		"%20s: %10lu\n", _label, ag->debug.int_stats._field);
 
 	struct ag71xx *ag = file->private_data;
-	char buf[256];
+	struct ag71xx_napi_stats *napi_stats = &ag->debug.napi_stats;
+	unsigned long irqs = ag->debug.int_stats.total;
+	u64 ppi = 0;
+	u32 rem = 0;
+	char buf[384];
 	unsigned int len = 0;
 
 	PR_INT_STAT("TX Packet Sent", tx_ps);
@@ -60,6 +64,17 @@ static ssize_t read_file_int_stats(struct file *file, char __user *user_buf,
 	PR_INT_STAT("RX Bus Error", rx_be);
 	len += snprintf(buf + len, sizeof(buf) - len, "\n");
 	PR_INT_STAT("Total", total);
+	PR_INT_STAT("Coalesce Timer", timer);
+
+	if (irqs) {
+		ppi = (u64) napi_stats->rx_packets + napi_stats->tx_packets;
+		ppi *= 100;
+		do_div(ppi, irqs);
+		rem = do_div(ppi, 100);
+	}
+	len += snprintf(buf + len, sizeof(buf) - len,
+			"%20s: %7llu.%02u\n", "Packets per IRQ",
+			(unsigned long long) ppi, rem);
 
 	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
 #undef PR_INT_STAT
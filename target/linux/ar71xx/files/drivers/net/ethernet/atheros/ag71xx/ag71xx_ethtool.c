@@ -118,6 +118,39 @@ static int ag71xx_ethtool_set_ringparam(struct net_device *dev,
 	return err;
 }
 
+static int ag71xx_ethtool_get_coalesce(struct net_device *dev,
+				       struct ethtool_coalesce *ec)
+{
+	struct ag71xx *ag = netdev_priv(dev);
+
+	ec->rx_coalesce_usecs = ag->coalesce_usecs;
+	ec->tx_coalesce_usecs = ag->coalesce_usecs;
+	ec->use_adaptive_rx_coalesce = ag->coalesce_adaptive;
+
+	return 0;
+}
+
+static int ag71xx_ethtool_set_coalesce(struct net_device *dev,
+				       struct ethtool_coalesce *ec)
+{
+	struct ag71xx *ag = netdev_priv(dev);
+	unsigned int usecs = ec->rx_coalesce_usecs;
+
+	/* RX and TX completions share one poll run, so one value for both */
+	if (ec->rx_coalesce_usecs != ec->tx_coalesce_usecs ||
+	    usecs > AG71XX_COALESCE_MAX_USECS)
+		return -EINVAL;
+
+	if (usecs && usecs < AG71XX_COALESCE_MIN_USECS)
+		usecs = AG71XX_COALESCE_MIN_USECS;
+
+	ag->coalesce_usecs = usecs;
+	ag->coalesce_cur_usecs = usecs;
+	ag->coalesce_adaptive = !!ec->use_adaptive_rx_coalesce;
+
+	return 0;
+}
+
 struct ethtool_ops ag71xx_ethtool_ops = {
 	.set_settings	= ag71xx_ethtool_set_settings,
 	.get_settings	= ag71xx_ethtool_get_settings,
@@ -126,5 +159,7 @@ struct ethtool_ops ag71xx_ethtool_ops = {
 	.set_msglevel	= ag71xx_ethtool_set_msglevel,
 	.get_ringparam	= ag71xx_ethtool_get_ringparam,
 	.set_ringparam	= ag71xx_ethtool_set_ringparam,
+	.get_coalesce	= ag71xx_ethtool_get_coalesce,
+	.set_coalesce	= ag71xx_ethtool_set_coalesce,
 	.get_link	= ethtool_op_get_link,
 };
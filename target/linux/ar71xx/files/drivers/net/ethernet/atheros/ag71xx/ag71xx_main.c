@@ -678,6 +678,7 @@ static int ag71xx_stop(struct net_device *dev)
 
 	napi_disable(&ag->napi);
 	del_timer_sync(&ag->oom_timer);
+	hrtimer_cancel(&ag->coalesce_timer);
 
 	spin_unlock_irqrestore(&ag->lock, flags);
 
@@ -851,6 +852,47 @@ static void ag71xx_oom_timer_handler(unsigned long data)
 	napi_schedule(&ag->napi);
 }
 
+static enum hrtimer_restart ag71xx_coalesce_timer_handler(struct hrtimer *t)
+{
+	struct ag71xx *ag = container_of(t, struct ag71xx, coalesce_timer);
+
+	ag71xx_debugfs_update_timer_stats(ag);
+	napi_schedule(&ag->napi);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Software interrupt moderation: instead of re-enabling the interrupts
+ * when a poll run finished with work done, poll again after the
+ * configured delay. Interrupts are only re-enabled once a poll run
+ * finds the rings idle. In adaptive mode the delay is scaled so that a
+ * poll run sees about half of its budget, and low packet rates go back
+ * to plain interrupt mode.
+ */
+static bool ag71xx_coalesce_rearm(struct ag71xx *ag, int done, int limit)
+{
+	unsigned int usecs = ag->coalesce_usecs;
+
+	if (!usecs || !done)
+		return false;
+
+	if (ag->coalesce_adaptive) {
+		if (done < limit / 8)
+			return false;
+
+		usecs = ag->coalesce_cur_usecs * (limit / 2) / done;
+		usecs = clamp_t(unsigned int, usecs, AG71XX_COALESCE_MIN_USECS,
+				ag->coalesce_usecs);
+		ag->coalesce_cur_usecs = usecs;
+	}
+
+	hrtimer_start(&ag->coalesce_timer, ns_to_ktime(usecs * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+
+	return true;
+}
+
 static void ag71xx_tx_timeout(struct net_device *dev)
 {
 	struct ag71xx *ag = netdev_priv(dev);
@@ -1072,6 +1114,9 @@ static int ag71xx_poll(struct napi_struct *napi, int limit)
 
 		napi_complete(napi);
 
+		if (ag71xx_coalesce_rearm(ag, rx_done + tx_done, limit))
+			return rx_done;
+
 		/* enable interrupts */
 		spin_lock_irqsave(&ag->lock, flags);
 		ag71xx_int_enable(ag, AG71XX_INT_POLL);
@@ -1265,6 +1310,9 @@ static int ag71xx_probe(struct platform_device *pdev)
 	ag->oom_timer.data = (unsigned long) dev;
 	ag->oom_timer.function = ag71xx_oom_timer_handler;
 
+	hrtimer_init(&ag->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ag->coalesce_timer.function = ag71xx_coalesce_timer_handler;
+
 	ag->tx_ring.size = AG71XX_TX_RING_SIZE_DEFAULT;
 	ag->rx_ring.size = AG71XX_RX_RING_SIZE_DEFAULT;
 
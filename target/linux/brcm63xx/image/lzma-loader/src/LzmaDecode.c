@@ -59,7 +59,21 @@
   { UpdateBit0(p); mi <<= 1; A0; } else \
   { UpdateBit1(p); mi = (mi + mi) + 1; A1; } 
   
+#ifdef _LZMA_BRANCHLESS
+/* Plain bit tree decoding selects the new range, code and probability
+   with a mask built from the compare instead of branching on the bit,
+   which lets the compiler use conditional moves on MIPS32. */
+#define RC_GET_BIT(p, mi) { UInt32 mask; UInt32 prob0 = *(p); RC_NORMALIZE; \
+  bound = (Range >> kNumBitModelTotalBits) * prob0; \
+  mask = 0 - (UInt32)(Code >= bound); \
+  Range = bound ^ ((bound ^ (Range - bound)) & mask); \
+  Code -= bound & mask; \
+  *(p) = (CProb)(((prob0 + ((kBitModelTotal - prob0) >> kNumMoveBits)) & ~mask) | \
+    ((prob0 - (prob0 >> kNumMoveBits)) & mask)); \
+  mi = (mi + mi) + (mask & 1); }
+#else
 #define RC_GET_BIT(p, mi) RC_GET_BIT2(p, mi, ; , ;)               
+#endif
 
 #define RangeDecoderBitTreeDecode(probs, numLevels, res) \
   { int i = numLevels; res = 1; \
@@ -24,6 +24,7 @@
 
 #include "config.h"
 #include "cache.h"
+#include "cp0regdef.h"
 #include "printf.h"
 #include "LzmaDecode.h"
 
@@ -98,7 +99,10 @@ static int lzma_decompress(unsigned char *outStream)
 	SizeT ip, op;
 	int ret;
 
-	lzma_state.Probs = (CProb *) workspace;
+	/* keep the probability table on cache line boundaries */
+	lzma_state.Probs = (CProb *) (((unsigned long) workspace +
+				      CONFIG_CACHELINE_SIZE - 1) &
+				     ~(CONFIG_CACHELINE_SIZE - 1));
 
 	ret = LzmaDecode(&lzma_state, lzma_data, lzma_datasize, &ip, outStream,
 			 lzma_outsize, &op);
@@ -133,6 +137,7 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 {
 	void (*kernel_entry) (unsigned long, unsigned long, unsigned long,
 			      unsigned long);
+	unsigned long ticks;
 	int res;
 
 	board_init();
@@ -151,7 +156,9 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 
 	printf("Decompressing kernel... ");
 
+	ticks = read_32bit_c0_register($9, 0);
 	res = lzma_decompress((unsigned char *) kernel_la);
+	ticks = read_32bit_c0_register($9, 0) - ticks;
 	if (res != LZMA_RESULT_OK) {
 		printf("failed, ");
 		switch (res) {
@@ -166,6 +173,10 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 		printf("done!\n");
 	}
 
+	/* the count register runs at half of the cpu clock */
+	printf("Decompressed %d bytes in %u cycles\n", lzma_outsize,
+	       ticks * 2);
+
 	flush_cache(kernel_la, lzma_outsize);
 
 	printf("Starting kernel at %08x...\n\n", kernel_la);
@@ -50,6 +50,7 @@
 #include <linux/random.h>
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,10)
 #include <linux/scatterlist.h>
 #endif
@@ -87,12 +88,24 @@ struct {
 
 #define SCATTERLIST_MAX 16
 
+#define SW_POOL_BUSY		0
+
+/*
+ * hash/hmac tfms keep state during an operation, so each CPU gets its
+ * own tfm to avoid serialising parallel requests on the session tfm
+ */
+struct swcr_pool_tfm {
+	struct crypto_tfm	*tfm;
+	unsigned long		flags;
+};
+
 struct swcr_data {
 	struct work_struct  workq;
 	int					sw_type;
 	int					sw_alg;
 	struct crypto_tfm	*sw_tfm;
 	spinlock_t			sw_tfm_lock;
+	struct swcr_pool_tfm	*sw_pool;
 	union {
 		struct {
 			char *sw_key;
@@ -102,11 +115,37 @@ struct swcr_data {
 		void *sw_comp_buf;
 	} u;
 	struct swcr_data	*sw_next;
+	/* only used on the head of a session chain */
+	atomic_t			sw_refcnt;
+	struct rcu_head		sw_rcu;
+};
+
+/*
+ * Session ids carry the table index in the low bits and a per slot
+ * generation in the high bits so that a stale id of a freed (and
+ * possibly reused) slot never resolves to the new session.
+ */
+#define SWCR_SES_INDEX_BITS	20
+#define SWCR_SES_INDEX_MASK	((1 << SWCR_SES_INDEX_BITS) - 1)
+#define SWCR_SES_GEN_MASK	((1 << (32 - SWCR_SES_INDEX_BITS)) - 1)
+#define SWCR_SES_ID(idx, gen)	(((gen) << SWCR_SES_INDEX_BITS) | (idx))
+
+struct swcr_slot {
+	struct swcr_data	*sw;
+	u_int32_t			gen;
+	u_int32_t			next_free;
+};
+
+struct swcr_table {
+	struct rcu_head		rcu;
+	u_int32_t			size;
+	struct swcr_slot	slot[0];
 };
 
 struct swcr_req {
 	struct swcr_data	*sw_head;
 	struct swcr_data	*sw;
+	struct swcr_pool_tfm	*pool_tfm;
 	struct cryptop		*crp;
 	struct cryptodesc	*crd;
 	struct scatterlist	 sg[SCATTERLIST_MAX];
@@ -263,12 +302,40 @@ module_param(swcr_no_ablk, int, 0644);
 MODULE_PARM_DESC(swcr_no_ablk,
                 "Do not use async blk ciphers even if available");
 
-static struct swcr_data **swcr_sessions = NULL;
-static u_int32_t swcr_sesnum = 0;
+/* bumped from softirq and workqueue context on any CPU */
+static atomic_t swcr_deferrals = ATOMIC_INIT(0);
+static atomic_t swcr_pool_misses = ATOMIC_INIT(0);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+static int swcr_get_counter(char *buf, const struct kernel_param *kp)
+#else
+static int swcr_get_counter(char *buf, struct kernel_param *kp)
+#endif
+{
+	return sprintf(buf, "%d", atomic_read((atomic_t *) kp->arg));
+}
+
+module_param_call(swcr_deferrals, NULL, swcr_get_counter, &swcr_deferrals, 0444);
+MODULE_PARM_DESC(swcr_deferrals,
+                "Requests deferred because their session tfm was busy");
+
+module_param_call(swcr_pool_misses, NULL, swcr_get_counter, &swcr_pool_misses, 0444);
+MODULE_PARM_DESC(swcr_pool_misses,
+                "Hash requests that could not use a per-CPU tfm");
+
+/*
+ * lookups run under rcu_read_lock(),  swcr_table_lock serialises the
+ * updates and protects the free slot list
+ */
+static struct swcr_table *swcr_table = NULL;
+static u_int32_t swcr_free_slot = 0;
+static DEFINE_SPINLOCK(swcr_table_lock);
 
 static	int swcr_process(device_t, struct cryptop *, int);
 static	int swcr_newsession(device_t, u_int32_t *, struct cryptoini *);
 static	int swcr_freesession(device_t, u_int64_t);
+static	void swcr_free_chain(struct swcr_data *);
+static	u_int32_t swcr_table_insert(struct swcr_data *);
 
 static device_method_t swcr_methods = {
 	/* crypto device methods */
@@ -332,13 +399,94 @@ execute_later(void (fn)(void *), void *arg)
 	}
 }
 
+static void
+swcr_free_hash_tfm(int sw_type, struct crypto_tfm *tfm)
+{
+#ifdef HAVE_AHASH
+	if (sw_type & SW_TYPE_ASYNC) {
+		crypto_free_ahash(__crypto_ahash_cast(tfm));
+		return;
+	}
+#endif
+	crypto_free_hash(crypto_hash_cast(tfm));
+}
+
+/*
+ * Give each online CPU its own hash tfm.  This is done at session setup
+ * as allocating a tfm may sleep,  CPUs without one fall back to the
+ * shared session tfm (and its INUSE/execute_later handling).
+ */
+static void
+swcr_pool_init(struct swcr_data *sw, char *algo)
+{
+#ifdef HAVE_AHASH
+	struct crypto_ahash *ahash;
+#endif
+	struct crypto_hash *hash;
+	int cpu;
+
+	if (num_online_cpus() < 2)
+		return;
+
+	sw->sw_pool = kmalloc(nr_cpu_ids * sizeof(*sw->sw_pool), SLAB_ATOMIC);
+	if (sw->sw_pool == NULL)
+		return;
+	memset(sw->sw_pool, 0, nr_cpu_ids * sizeof(*sw->sw_pool));
+
+	for_each_online_cpu(cpu) {
+#ifdef HAVE_AHASH
+		if (sw->sw_type & SW_TYPE_ASYNC) {
+			ahash = crypto_alloc_ahash(algo, 0, 0);
+			if (!IS_ERR_OR_NULL(ahash))
+				sw->sw_pool[cpu].tfm = crypto_ahash_tfm(ahash);
+			continue;
+		}
+#endif
+		hash = crypto_alloc_hash(algo, 0, CRYPTO_ALG_ASYNC);
+		if (!IS_ERR_OR_NULL(hash))
+			sw->sw_pool[cpu].tfm = crypto_hash_tfm(hash);
+	}
+}
+
+static void
+swcr_pool_free(struct swcr_data *sw)
+{
+	int cpu;
+
+	if (sw->sw_pool == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		if (sw->sw_pool[cpu].tfm)
+			swcr_free_hash_tfm(sw->sw_type, sw->sw_pool[cpu].tfm);
+	kfree(sw->sw_pool);
+	sw->sw_pool = NULL;
+}
+
+static struct swcr_pool_tfm *
+swcr_pool_get(struct swcr_data *sw)
+{
+	struct swcr_pool_tfm *pt;
+
+	if (sw->sw_pool == NULL)
+		return NULL;
+
+	/* any slot will do,  the busy bit protects against preemption */
+	pt = &sw->sw_pool[raw_smp_processor_id()];
+	if (pt->tfm && !test_and_set_bit_lock(SW_POOL_BUSY, &pt->flags))
+		return pt;
+
+	atomic_inc(&swcr_pool_misses);
+	return NULL;
+}
+
 /*
  * Generate a new software session.
  */
 static int
 swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 {
-	struct swcr_data **swd;
+	struct swcr_data **swd, *sw_head;
 	u_int32_t i;
 	int error;
 	char *algo;
@@ -350,50 +498,14 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 		return EINVAL;
 	}
 
-	if (swcr_sessions) {
-		for (i = 1; i < swcr_sesnum; i++)
-			if (swcr_sessions[i] == NULL)
-				break;
-	} else
-		i = 1;		/* NB: to silence compiler warning */
-
-	if (swcr_sessions == NULL || i == swcr_sesnum) {
-		if (swcr_sessions == NULL) {
-			i = 1; /* We leave swcr_sessions[0] empty */
-			swcr_sesnum = CRYPTO_SW_SESSIONS;
-		} else
-			swcr_sesnum *= 2;
-
-		swd = kmalloc(swcr_sesnum * sizeof(struct swcr_data *), SLAB_ATOMIC);
-		if (swd == NULL) {
-			/* Reset session number */
-			if (swcr_sesnum == CRYPTO_SW_SESSIONS)
-				swcr_sesnum = 0;
-			else
-				swcr_sesnum /= 2;
-			dprintk("%s,%d: ENOBUFS\n", __FILE__, __LINE__);
-			return ENOBUFS;
-		}
-		memset(swd, 0, swcr_sesnum * sizeof(struct swcr_data *));
-
-		/* Copy existing sessions */
-		if (swcr_sessions) {
-			memcpy(swd, swcr_sessions,
-			    (swcr_sesnum / 2) * sizeof(struct swcr_data *));
-			kfree(swcr_sessions);
-		}
-
-		swcr_sessions = swd;
-	}
-
-	swd = &swcr_sessions[i];
-	*sid = i;
+	sw_head = NULL;
+	swd = &sw_head;
 
 	while (cri) {
 		*swd = (struct swcr_data *) kmalloc(sizeof(struct swcr_data),
 				SLAB_ATOMIC);
 		if (*swd == NULL) {
-			swcr_freesession(NULL, i);
+			swcr_free_chain(sw_head);
 			dprintk("%s,%d: ENOBUFS\n", __FILE__, __LINE__);
 			return ENOBUFS;
 		}
@@ -402,14 +514,14 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 		if (cri->cri_alg < 0 ||
 				cri->cri_alg>=sizeof(crypto_details)/sizeof(crypto_details[0])){
 			printk("cryptosoft: Unknown algorithm 0x%x\n", cri->cri_alg);
-			swcr_freesession(NULL, i);
+			swcr_free_chain(sw_head);
 			return EINVAL;
 		}
 
 		algo = crypto_details[cri->cri_alg].alg_name;
 		if (!algo || !*algo) {
 			printk("cryptosoft: Unsupported algorithm 0x%x\n", cri->cri_alg);
-			swcr_freesession(NULL, i);
+			swcr_free_chain(sw_head);
 			return EINVAL;
 		}
 
@@ -450,7 +562,7 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 						algo,mode);
 				err = IS_ERR((*swd)->sw_tfm) ? -(PTR_ERR((*swd)->sw_tfm)) : EINVAL;
 				(*swd)->sw_tfm = NULL; /* ensure NULL */
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				return err;
 			}
 
@@ -482,7 +594,7 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 			if (error) {
 				printk("cryptosoft: setkey failed %d (crt_flags=0x%x)\n", error,
 						(*swd)->sw_tfm->crt_flags);
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				return error;
 			}
 		} else if ((*swd)->sw_type & (SW_TYPE_HMAC | SW_TYPE_HASH)) {
@@ -504,7 +616,7 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 			if (!(*swd)->sw_tfm) {
 				dprintk("cryptosoft: crypto_alloc_hash failed(%s,0x%x)\n",
 						algo, mode);
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				return EINVAL;
 			}
 
@@ -512,7 +624,7 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 			(*swd)->u.hmac.sw_key = (char *)kmalloc((*swd)->u.hmac.sw_klen,
 					SLAB_ATOMIC);
 			if ((*swd)->u.hmac.sw_key == NULL) {
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				dprintk("%s,%d: ENOBUFS\n", __FILE__, __LINE__);
 				return ENOBUFS;
 			}
@@ -526,55 +638,53 @@ swcr_newsession(device_t dev, u_int32_t *sid, struct cryptoini *cri)
 				(*swd)->u.hmac.sw_mlen = crypto_hash_digestsize(
 						crypto_hash_cast((*swd)->sw_tfm));
 			}
+
+			swcr_pool_init(*swd, algo);
 		} else if ((*swd)->sw_type & SW_TYPE_COMP) {
 			(*swd)->sw_tfm = crypto_comp_tfm(
 					crypto_alloc_comp(algo, 0, CRYPTO_ALG_ASYNC));
 			if (!(*swd)->sw_tfm) {
 				dprintk("cryptosoft: crypto_alloc_comp failed(%s,0x%x)\n",
 						algo, mode);
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				return EINVAL;
 			}
 			(*swd)->u.sw_comp_buf = kmalloc(CRYPTO_MAX_DATA_LEN, SLAB_ATOMIC);
 			if ((*swd)->u.sw_comp_buf == NULL) {
-				swcr_freesession(NULL, i);
+				swcr_free_chain(sw_head);
 				dprintk("%s,%d: ENOBUFS\n", __FILE__, __LINE__);
 				return ENOBUFS;
 			}
 		} else {
 			printk("cryptosoft: Unhandled sw_type %d\n", (*swd)->sw_type);
-			swcr_freesession(NULL, i);
+			swcr_free_chain(sw_head);
 			return EINVAL;
 		}
 
 		cri = cri->cri_next;
 		swd = &((*swd)->sw_next);
 	}
+
+	/* the table holds the initial reference */
+	atomic_set(&sw_head->sw_refcnt, 1);
+	i = swcr_table_insert(sw_head);
+	if (i == 0) {
+		swcr_free_chain(sw_head);
+		dprintk("%s,%d: ENOBUFS\n", __FILE__, __LINE__);
+		return ENOBUFS;
+	}
+	*sid = i;
 	return 0;
 }
 
-/*
- * Free a session.
- */
-static int
-swcr_freesession(device_t dev, u_int64_t tid)
+static void
+swcr_free_chain(struct swcr_data *sw_head)
 {
 	struct swcr_data *swd;
-	u_int32_t sid = CRYPTO_SESID2LID(tid);
-
-	dprintk("%s()\n", __FUNCTION__);
-	if (sid > swcr_sesnum || swcr_sessions == NULL ||
-			swcr_sessions[sid] == NULL) {
-		dprintk("%s,%d: EINVAL\n", __FILE__, __LINE__);
-		return(EINVAL);
-	}
-
-	/* Silently accept and return */
-	if (sid == 0)
-		return(0);
 
-	while ((swd = swcr_sessions[sid]) != NULL) {
-		swcr_sessions[sid] = swd->sw_next;
+	while ((swd = sw_head) != NULL) {
+		sw_head = swd->sw_next;
+		swcr_pool_free(swd);
 		if (swd->sw_tfm) {
 			switch (swd->sw_type & SW_TYPE_ALG_AMASK) {
 #ifdef HAVE_AHASH
@@ -616,6 +726,153 @@ swcr_freesession(device_t dev, u_int64_t tid)
 		}
 		kfree(swd);
 	}
+}
+
+static void
+swcr_free_chain_rcu(struct rcu_head *head)
+{
+	swcr_free_chain(container_of(head, struct swcr_data, sw_rcu));
+}
+
+static void
+swcr_table_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct swcr_table, rcu));
+}
+
+/*
+ * Drop a reference on a session chain,  the last one frees it.  Lookups
+ * may still be looking at the head so it goes after a grace period.
+ */
+static void
+swcr_session_put(struct swcr_data *sw_head)
+{
+	if (atomic_dec_and_test(&sw_head->sw_refcnt))
+		call_rcu(&sw_head->sw_rcu, swcr_free_chain_rcu);
+}
+
+/*
+ * Resolve a session id,  no locks taken.  Returns the session chain with
+ * a reference held that the caller drops with swcr_session_put() once
+ * the request is done with it.
+ */
+static struct swcr_data *
+swcr_session_lookup(u_int32_t lid)
+{
+	u_int32_t idx = lid & SWCR_SES_INDEX_MASK;
+	struct swcr_data *sw = NULL;
+	struct swcr_table *t;
+
+	rcu_read_lock();
+	t = rcu_dereference(swcr_table);
+	if (t && idx != 0 && idx < t->size &&
+			t->slot[idx].gen == (lid >> SWCR_SES_INDEX_BITS))
+		sw = rcu_dereference(t->slot[idx].sw);
+	if (sw && !atomic_inc_not_zero(&sw->sw_refcnt))
+		sw = NULL;
+	rcu_read_unlock();
+
+	return sw;
+}
+
+/*
+ * Double the table,  the new slots are put on the free list.
+ * Called with swcr_table_lock held.
+ */
+static int
+swcr_table_grow(void)
+{
+	struct swcr_table *old = swcr_table, *t;
+	u_int32_t size, i;
+
+	size = old ? old->size * 2 : CRYPTO_SW_SESSIONS;
+	if (size > SWCR_SES_INDEX_MASK + 1)
+		return ENOBUFS;
+
+	t = kmalloc(sizeof(*t) + size * sizeof(t->slot[0]), SLAB_ATOMIC);
+	if (t == NULL)
+		return ENOBUFS;
+	memset(t, 0, sizeof(*t) + size * sizeof(t->slot[0]));
+	t->size = size;
+
+	i = 1; /* slot 0 stays empty */
+	if (old) {
+		memcpy(t->slot, old->slot, old->size * sizeof(t->slot[0]));
+		i = old->size;
+	}
+	for (; i < size; i++)
+		t->slot[i].next_free = (i + 1 < size) ? i + 1 : swcr_free_slot;
+	swcr_free_slot = old ? old->size : 1;
+
+	rcu_assign_pointer(swcr_table, t);
+	if (old)
+		call_rcu(&old->rcu, swcr_table_free_rcu);
+	return 0;
+}
+
+/*
+ * Publish a new session,  returns its id or 0 on failure.
+ */
+static u_int32_t
+swcr_table_insert(struct swcr_data *sw_head)
+{
+	struct swcr_slot *slot;
+	unsigned long flags;
+	u_int32_t idx;
+
+	spin_lock_irqsave(&swcr_table_lock, flags);
+	if (swcr_free_slot == 0 && swcr_table_grow()) {
+		spin_unlock_irqrestore(&swcr_table_lock, flags);
+		return 0;
+	}
+	idx = swcr_free_slot;
+	slot = &swcr_table->slot[idx];
+	swcr_free_slot = slot->next_free;
+	rcu_assign_pointer(slot->sw, sw_head);
+	idx = SWCR_SES_ID(idx, slot->gen);
+	spin_unlock_irqrestore(&swcr_table_lock, flags);
+
+	return idx;
+}
+
+/*
+ * Free a session.
+ */
+static int
+swcr_freesession(device_t dev, u_int64_t tid)
+{
+	struct swcr_data *sw_head = NULL;
+	u_int32_t sid = CRYPTO_SESID2LID(tid);
+	u_int32_t idx = sid & SWCR_SES_INDEX_MASK;
+	struct swcr_slot *slot;
+	unsigned long flags;
+
+	dprintk("%s()\n", __FUNCTION__);
+
+	/* Silently accept and return */
+	if (sid == 0)
+		return(0);
+
+	spin_lock_irqsave(&swcr_table_lock, flags);
+	if (swcr_table && idx != 0 && idx < swcr_table->size) {
+		slot = &swcr_table->slot[idx];
+		if (slot->sw && slot->gen == (sid >> SWCR_SES_INDEX_BITS)) {
+			sw_head = slot->sw;
+			rcu_assign_pointer(slot->sw, NULL);
+			slot->gen = (slot->gen + 1) & SWCR_SES_GEN_MASK;
+			slot->next_free = swcr_free_slot;
+			swcr_free_slot = idx;
+		}
+	}
+	spin_unlock_irqrestore(&swcr_table_lock, flags);
+
+	if (sw_head == NULL) {
+		dprintk("%s,%d: EINVAL\n", __FILE__, __LINE__);
+		return(EINVAL);
+	}
+
+	/* requests still running on the session keep it alive */
+	swcr_session_put(sw_head);
 	return 0;
 }
 
@@ -623,7 +880,10 @@ static void swcr_process_req_complete(struct swcr_req *req)
 {
 	dprintk("%s()\n", __FUNCTION__);
 
-	if (req->sw->sw_type & SW_TYPE_INUSE) {
+	if (req->pool_tfm) {
+		clear_bit_unlock(SW_POOL_BUSY, &req->pool_tfm->flags);
+		req->pool_tfm = NULL;
+	} else if (req->sw->sw_type & SW_TYPE_INUSE) {
 		unsigned long flags;
 		spin_lock_irqsave(&req->sw->sw_tfm_lock, flags);
 		req->sw->sw_type &= ~SW_TYPE_INUSE;
@@ -667,6 +927,7 @@ static void swcr_process_req_complete(struct swcr_req *req)
 done:
 	dprintk("%s crypto_done %p\n", __FUNCTION__, req);
 	crypto_done(req->crp);
+	swcr_session_put(req->sw_head);
 	kmem_cache_free(swcr_req_cache, req);
 }
 
@@ -731,9 +992,15 @@ static void swcr_process_req(struct swcr_req *req)
 	case SW_TYPE_HMAC:
 	case SW_TYPE_HASH: {
 		unsigned long flags;
+
+		req->pool_tfm = swcr_pool_get(sw);
+		if (req->pool_tfm)
+			break;
+
 		spin_lock_irqsave(&sw->sw_tfm_lock, flags);
 		if (sw->sw_type & SW_TYPE_INUSE) {
 			spin_unlock_irqrestore(&sw->sw_tfm_lock, flags);
+			atomic_inc(&swcr_deferrals);
 			execute_later((void (*)(void *))swcr_process_req, (void *)req);
 			return;
 		}
@@ -823,6 +1090,7 @@ static void swcr_process_req(struct swcr_req *req)
 	case SW_TYPE_AHMAC:
 	case SW_TYPE_AHASH:
 		{
+		struct crypto_tfm *tfm = req->pool_tfm ? req->pool_tfm->tfm : sw->sw_tfm;
 		int ret;
 
 		/* check we have room for the result */
@@ -835,7 +1103,7 @@ static void swcr_process_req(struct swcr_req *req)
 		}
 
 		req->crypto_req =
-				ahash_request_alloc(__crypto_ahash_cast(sw->sw_tfm),GFP_ATOMIC);
+				ahash_request_alloc(__crypto_ahash_cast(tfm),GFP_ATOMIC);
 		if (!req->crypto_req) {
 			crp->crp_etype = ENOMEM;
 			dprintk("%s,%d: ENOMEM ahash_request_alloc", __FILE__, __LINE__);
@@ -848,7 +1116,7 @@ static void swcr_process_req(struct swcr_req *req)
 		memset(req->result, 0, sizeof(req->result));
 
 		if (sw->sw_type & SW_TYPE_AHMAC)
-			crypto_ahash_setkey(__crypto_ahash_cast(sw->sw_tfm),
+			crypto_ahash_setkey(__crypto_ahash_cast(tfm),
 					sw->u.hmac.sw_key, sw->u.hmac.sw_klen);
 		ahash_request_set_crypt(req->crypto_req, req->sg, req->result, sg_len);
 		ret = crypto_ahash_digest(req->crypto_req);
@@ -1044,6 +1312,7 @@ static void swcr_process_req(struct swcr_req *req)
 	case SW_TYPE_HMAC:
 	case SW_TYPE_HASH:
 		{
+		struct crypto_tfm *tfm = req->pool_tfm ? req->pool_tfm->tfm : sw->sw_tfm;
 		char result[HASH_MAX_LEN];
 		struct hash_desc desc;
 
@@ -1057,13 +1326,13 @@ static void swcr_process_req(struct swcr_req *req)
 		}
 
 		memset(&desc, 0, sizeof(desc));
-		desc.tfm = crypto_hash_cast(sw->sw_tfm);
+		desc.tfm = crypto_hash_cast(tfm);
 
 		memset(result, 0, sizeof(result));
 
 		if (sw->sw_type & SW_TYPE_HMAC) {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
-			crypto_hmac(sw->sw_tfm, sw->u.hmac.sw_key, &sw->u.hmac.sw_klen,
+			crypto_hmac(tfm, sw->u.hmac.sw_key, &sw->u.hmac.sw_klen,
 					req->sg, sg_num, result);
 #else
 			crypto_hash_setkey(desc.tfm, sw->u.hmac.sw_key,
@@ -1161,6 +1430,7 @@ static int
 swcr_process(device_t dev, struct cryptop *crp, int hint)
 {
 	struct swcr_req *req = NULL;
+	struct swcr_data *sw_head = NULL;
 	u_int32_t lid;
 
 	dprintk("%s()\n", __FUNCTION__);
@@ -1179,8 +1449,8 @@ swcr_process(device_t dev, struct cryptop *crp, int hint)
 	}
 
 	lid = crp->crp_sid & 0xffffffff;
-	if (lid >= swcr_sesnum || lid == 0 || swcr_sessions == NULL ||
-			swcr_sessions[lid] == NULL) {
+	sw_head = swcr_session_lookup(lid);
+	if (sw_head == NULL) {
 		crp->crp_etype = ENOENT;
 		dprintk("%s,%d: ENOENT\n", __FILE__, __LINE__);
 		goto done;
@@ -1217,7 +1487,7 @@ swcr_process(device_t dev, struct cryptop *crp, int hint)
 	}
 	memset(req, 0, sizeof(*req));
 
-	req->sw_head = swcr_sessions[lid];
+	req->sw_head = sw_head;
 	req->crp = crp;
 	req->crd = crp->crp_desc;
 
@@ -1226,6 +1496,8 @@ swcr_process(device_t dev, struct cryptop *crp, int hint)
 
 done:
 	crypto_done(crp);
+	if (sw_head)
+		swcr_session_put(sw_head);
 	if (req)
 		kmem_cache_free(swcr_req_cache, req);
 	return 0;
@@ -1311,6 +1583,9 @@ cryptosoft_exit(void)
 	dprintk("%s()\n", __FUNCTION__);
 	crypto_unregister_all(swcr_id);
 	swcr_id = -1;
+	rcu_barrier();
+	kfree(swcr_table);
+	swcr_table = NULL;
 	kmem_cache_destroy(swcr_req_cache);
 }
 
@@ -42,6 +42,8 @@
 #include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
 #include <cryptodev.h>
 
 #ifdef I_HAVE_AN_XSCALE_WITH_INTEL_SDK
@@ -99,6 +101,14 @@ static int request_cbimm = 1;
 module_param(request_cbimm, int, 0);
 MODULE_PARM_DESC(request_cbimm, "enable OCF immediate callback on completion");
 
+/*
+ * create and free this many sessions while the OCF benchmark runs,  the
+ * traffic is moved to each new session before the old one is freed
+ */
+static int session_churn = 0;
+module_param(session_churn, int, 0);
+MODULE_PARM_DESC(session_churn, "sessions to create and free under traffic");
+
 /*
  * a structure for each request
  */
@@ -123,6 +133,10 @@ static int total;
 
 static uint64_t ocf_cryptoid;
 static unsigned long jstart, jstop;
+static int churn_done;
+static int churn_count;
+static int churn_stale;
+static DECLARE_COMPLETION(churn_exit);
 
 static int ocf_init(void);
 static int ocf_cb(struct cryptop *crp);
@@ -132,16 +146,13 @@ static void ocf_request_wq(struct work_struct *work);
 #endif
 
 static int
-ocf_init(void)
+ocf_newsession(uint64_t *sid)
 {
 	int error;
 	struct cryptoini crie, cria;
-	struct cryptodesc crda, crde;
 
 	memset(&crie, 0, sizeof(crie));
 	memset(&cria, 0, sizeof(cria));
-	memset(&crde, 0, sizeof(crde));
-	memset(&crda, 0, sizeof(crda));
 
 	cria.cri_alg  = CRYPTO_SHA1_HMAC;
 	cria.cri_klen = 20 * 8;
@@ -154,7 +165,7 @@ ocf_init(void)
 
 	crie.cri_next = &cria;
 
-	error = crypto_newsession(&ocf_cryptoid, &crie,
+	error = crypto_newsession(sid, &crie,
 				CRYPTOCAP_F_HARDWARE | CRYPTOCAP_F_SOFTWARE);
 	if (error) {
 		printk("crypto_newsession failed %d\n", error);
@@ -163,21 +174,65 @@ ocf_init(void)
 	return 0;
 }
 
+static int
+ocf_init(void)
+{
+	return ocf_newsession(&ocf_cryptoid);
+}
+
+/*
+ * swap the session used by the traffic for a new one and free the old
+ * one while requests on it may still be in flight
+ */
+static int
+ocf_churn(void *arg)
+{
+	uint64_t sid, old;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < session_churn; i++) {
+		if (ocf_newsession(&sid) == -1) {
+			printk("OCF: session churn stopped after %d sessions\n", i);
+			break;
+		}
+		spin_lock_irqsave(&ocfbench_counter_lock, flags);
+		old = ocf_cryptoid;
+		ocf_cryptoid = sid;
+		spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
+		crypto_freesession(old);
+		if ((i & 0xff) == 0xff)
+			cond_resched();
+	}
+
+	churn_count = i;
+	churn_done = 1;
+	/* the module may go away as soon as init sees this */
+	complete_and_exit(&churn_exit, 0);
+	return 0;
+}
+
 static int
 ocf_cb(struct cryptop *crp)
 {
 	request_t *r = (request_t *) crp->crp_opaque;
 	unsigned long flags;
 
-	if (crp->crp_etype)
+	spin_lock_irqsave(&ocfbench_counter_lock, flags);
+	/* a session freed by the churn thread is expected to go away */
+	if (session_churn && (crp->crp_etype == ENOENT ||
+			crp->crp_etype == EINVAL))
+		churn_stale++;
+	else if (crp->crp_etype)
 		printk("Error in OCF processing: %d\n", crp->crp_etype);
+	spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
 	crypto_freereq(crp);
 	crp = NULL;
 
-	/* do all requests  but take at least 1 second */
+	/* do all requests  but take at least 1 second (and the churn) */
 	spin_lock_irqsave(&ocfbench_counter_lock, flags);
 	total++;
-	if (total > request_num && jstart + HZ < jiffies) {
+	if (total > request_num && jstart + HZ < jiffies && churn_done) {
 		outstanding--;
 		spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
 		return 0;
@@ -232,7 +287,9 @@ ocf_request(void *arg)
 		crp->crp_flags |= CRYPTO_F_CBIMM;
 	crp->crp_buf = (caddr_t) r->buffer;
 	crp->crp_callback = ocf_cb;
+	spin_lock_irqsave(&ocfbench_counter_lock, flags);
 	crp->crp_sid = ocf_cryptoid;
+	spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
 	crp->crp_opaque = (caddr_t) r;
 	crypto_dispatch(crp);
 }
@@ -441,6 +498,16 @@ ocfbench_init(void)
 
 	spin_lock_init(&ocfbench_counter_lock);
 	total = outstanding = 0;
+	churn_count = churn_stale = 0;
+	churn_done = 1;
+	if (session_churn > 0) {
+		churn_done = 0;
+		if (IS_ERR(kthread_run(ocf_churn, NULL, "ocf-churn"))) {
+			printk("OCF: failed to start the session churn thread\n");
+			churn_done = 1;
+			complete(&churn_exit);
+		}
+	}
 	jstart = jiffies;
 	for (i = 0; i < request_q_len; i++) {
 		spin_lock_irqsave(&ocfbench_counter_lock, flags);
@@ -448,9 +515,15 @@ ocfbench_init(void)
 		spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
 		ocf_request(&requests[i]);
 	}
-	while (outstanding > 0)
+	while (outstanding > 0 || !churn_done)
 		schedule();
 	jstop = jiffies;
+	if (session_churn > 0) {
+		wait_for_completion(&churn_exit);
+		printk("OCF: %d sessions created and freed under traffic, "
+				"%d requests found their session gone\n",
+				churn_count, churn_stale);
+	}
 
 	mbps = 0;
 	if (jstop > jstart) {
@@ -22,7 +22,6 @@
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/device.h>
-#include <linux/sysdev.h>
 #include <linux/netdevice.h>
 #include <linux/timer.h>
 #include <linux/ctype.h>
@@ -42,6 +41,10 @@
  *   tx:   LED blinks on transmitted data
  *   rx:   LED blinks on receive data
  *
+ * Read-only sysfs attributes:
+ *
+ * stats_rate - statistics fetches per second from the monitored device
+ *
  * Some suggestions:
  *
  *  Simple link status LED:
@@ -68,15 +71,37 @@
 #define MODE_TX   2
 #define MODE_RX   4
 
+/*
+ * All LEDs blinking on the activity of the same net device share one
+ * sampler, so the (possibly expensive) statistics of the device are
+ * fetched once per tick no matter how many LEDs watch it. The sampler
+ * only exists while at least one LED is in tx/rx mode with the link up.
+ */
+struct netdev_trig_sampler {
+	struct list_head list;
+	struct list_head leds;
+
+	struct net_device *net_dev;
+	struct timer_list timer;
+	unsigned interval;
+
+	unsigned long rate_start;
+	unsigned samples;
+	unsigned rate;
+};
+
 struct led_netdev_data {
 	rwlock_t lock;
 
-	struct timer_list timer;
 	struct notifier_block notifier;
 
 	struct led_classdev *led_cdev;
 	struct net_device *net_dev;
 
+	struct netdev_trig_sampler *sampler;
+	struct list_head sampler_list;
+	unsigned long next_update;
+
 	char device_name[IFNAMSIZ];
 	unsigned interval;
 	unsigned mode;
@@ -84,6 +109,97 @@ struct led_netdev_data {
 	unsigned last_activity;
 };
 
+/* protects the sampler list and the LEDs attached to the samplers */
+static DEFINE_SPINLOCK(netdev_trig_sampler_lock);
+static LIST_HEAD(netdev_trig_samplers);
+
+/* align the ticks of the samplers so that their timers expire together */
+static unsigned long netdev_trig_next_tick(unsigned interval)
+{
+	return (jiffies / interval + 1) * interval;
+}
+
+static void netdev_trig_sampler_timer(unsigned long arg);
+
+static void netdev_trig_sampler_detach(struct led_netdev_data *trigger_data)
+{
+	struct netdev_trig_sampler *sampler = trigger_data->sampler;
+	struct led_netdev_data *other;
+
+	if (!sampler)
+		return;
+
+	spin_lock_bh(&netdev_trig_sampler_lock);
+
+	list_del(&trigger_data->sampler_list);
+	trigger_data->sampler = NULL;
+
+	if (!list_empty(&sampler->leds)) {
+		sampler->interval = UINT_MAX;
+		list_for_each_entry(other, &sampler->leds, sampler_list)
+			sampler->interval = min(sampler->interval, other->interval);
+
+		spin_unlock_bh(&netdev_trig_sampler_lock);
+		return;
+	}
+
+	list_del(&sampler->list);
+	spin_unlock_bh(&netdev_trig_sampler_lock);
+
+	/* the timer does not rearm itself once the sampler is unused */
+	del_timer_sync(&sampler->timer);
+	dev_put(sampler->net_dev);
+	kfree(sampler);
+}
+
+static void netdev_trig_sampler_attach(struct led_netdev_data *trigger_data)
+{
+	struct netdev_trig_sampler *sampler, *new;
+
+	if (trigger_data->sampler)
+		netdev_trig_sampler_detach(trigger_data);
+
+	new = kzalloc(sizeof(*new), GFP_ATOMIC);
+
+	spin_lock_bh(&netdev_trig_sampler_lock);
+
+	list_for_each_entry(sampler, &netdev_trig_samplers, list)
+		if (sampler->net_dev == trigger_data->net_dev)
+			goto found;
+
+	sampler = new;
+	if (!sampler) {
+		spin_unlock_bh(&netdev_trig_sampler_lock);
+		return;
+	}
+	new = NULL;
+
+	INIT_LIST_HEAD(&sampler->leds);
+	init_timer_deferrable(&sampler->timer);
+	sampler->timer.function = netdev_trig_sampler_timer;
+	sampler->timer.data = (unsigned long) sampler;
+	sampler->interval = UINT_MAX;
+	sampler->rate_start = jiffies;
+	dev_hold(trigger_data->net_dev);
+	sampler->net_dev = trigger_data->net_dev;
+	list_add(&sampler->list, &netdev_trig_samplers);
+
+found:
+	list_add(&trigger_data->sampler_list, &sampler->leds);
+	trigger_data->sampler = sampler;
+	trigger_data->next_update = jiffies;
+
+	if (trigger_data->interval < sampler->interval ||
+	    !timer_pending(&sampler->timer)) {
+		sampler->interval = min(sampler->interval, trigger_data->interval);
+		mod_timer(&sampler->timer, netdev_trig_next_tick(sampler->interval));
+	}
+
+	spin_unlock_bh(&netdev_trig_sampler_lock);
+
+	kfree(new);
+}
+
 static void set_baseline_state(struct led_netdev_data *trigger_data)
 {
 	if ((trigger_data->mode & MODE_LINK) != 0 && trigger_data->link_up)
@@ -91,10 +207,11 @@ static void set_baseline_state(struct led_netdev_data *trigger_data)
 	else
 		led_set_brightness(trigger_data->led_cdev, LED_OFF);
 
-	if ((trigger_data->mode & (MODE_TX | MODE_RX)) != 0 && trigger_data->link_up)
-		mod_timer(&trigger_data->timer, jiffies + trigger_data->interval);
+	if ((trigger_data->mode & (MODE_TX | MODE_RX)) != 0 && trigger_data->link_up &&
+	    trigger_data->net_dev)
+		netdev_trig_sampler_attach(trigger_data);
 	else
-		del_timer(&trigger_data->timer);
+		netdev_trig_sampler_detach(trigger_data);
 }
 
 static ssize_t led_device_name_show(struct device *dev,
@@ -250,11 +367,28 @@ static ssize_t led_interval_store(struct device *dev,
 
 static DEVICE_ATTR(interval, 0644, led_interval_show, led_interval_store);
 
+static ssize_t led_stats_rate_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct led_classdev *led_cdev = dev_get_drvdata(dev);
+	struct led_netdev_data *trigger_data = led_cdev->trigger_data;
+	unsigned rate = 0;
+
+	spin_lock_bh(&netdev_trig_sampler_lock);
+	if (trigger_data->sampler)
+		rate = trigger_data->sampler->rate;
+	spin_unlock_bh(&netdev_trig_sampler_lock);
+
+	return sprintf(buf, "%u\n", rate);
+}
+
+static DEVICE_ATTR(stats_rate, 0444, led_stats_rate_show, NULL);
+
 static int netdev_trig_notify(struct notifier_block *nb,
 			      unsigned long evt,
 			      void *dv)
 {
-	struct net_device *dev = dv;
+	struct net_device *dev = netdev_notifier_info_to_dev((struct netdev_notifier_info *) dv);
 	struct led_netdev_data *trigger_data = container_of(nb, struct led_netdev_data, notifier);
 
 	if (evt != NETDEV_UP && evt != NETDEV_DOWN && evt != NETDEV_CHANGE && evt != NETDEV_REGISTER && evt != NETDEV_UNREGISTER)
@@ -266,6 +400,7 @@ static int netdev_trig_notify(struct notifier_block *nb,
 		goto done;
 
 	if (evt == NETDEV_REGISTER) {
+		netdev_trig_sampler_detach(trigger_data);
 		if (trigger_data->net_dev != NULL)
 			dev_put(trigger_data->net_dev);
 		dev_hold(dev);
@@ -275,6 +410,7 @@ static int netdev_trig_notify(struct notifier_block *nb,
 	}
 
 	if (evt == NETDEV_UNREGISTER && trigger_data->net_dev != NULL) {
+		netdev_trig_sampler_detach(trigger_data);
 		dev_put(trigger_data->net_dev);
 		trigger_data->net_dev = NULL;
 		goto done;
@@ -291,21 +427,11 @@ done:
 }
 
 /* here's the real work! */
-static void netdev_trig_timer(unsigned long arg)
+static void netdev_trig_update(struct led_netdev_data *trigger_data,
+			       const struct rtnl_link_stats64 *dev_stats)
 {
-	struct led_netdev_data *trigger_data = (struct led_netdev_data *)arg;
-	const struct net_device_stats *dev_stats;
 	unsigned new_activity;
 
-	write_lock(&trigger_data->lock);
-
-	if (!trigger_data->link_up || !trigger_data->net_dev || (trigger_data->mode & (MODE_TX | MODE_RX)) == 0) {
-		/* we don't need to do timer work, just reflect link state. */
-		led_set_brightness(trigger_data->led_cdev, ((trigger_data->mode & MODE_LINK) != 0 && trigger_data->link_up) ? LED_FULL : LED_OFF);
-		goto no_restart;
-	}
-
-	dev_stats = dev_get_stats(trigger_data->net_dev);
 	new_activity =
 		((trigger_data->mode & MODE_TX) ? dev_stats->tx_packets : 0) +
 		((trigger_data->mode & MODE_RX) ? dev_stats->rx_packets : 0);
@@ -333,10 +459,51 @@ static void netdev_trig_timer(unsigned long arg)
 	}
 
 	trigger_data->last_activity = new_activity;
-	mod_timer(&trigger_data->timer, jiffies + trigger_data->interval);
+}
+
+static void netdev_trig_sampler_timer(unsigned long arg)
+{
+	struct netdev_trig_sampler *sampler = (struct netdev_trig_sampler *)arg;
+	struct led_netdev_data *trigger_data;
+	struct rtnl_link_stats64 *dev_stats;
+	struct rtnl_link_stats64 temp;
+
+	spin_lock(&netdev_trig_sampler_lock);
+
+	if (list_empty(&sampler->leds))
+		goto no_restart;
+
+	/* one fetch serves every LED of the device which is due */
+	dev_stats = dev_get_stats(sampler->net_dev, &temp);
+	sampler->samples++;
+
+	list_for_each_entry(trigger_data, &sampler->leds, sampler_list) {
+		if (time_before(jiffies, trigger_data->next_update))
+			continue;
+
+		/*
+		 * The sysfs and notifier writers take the sampler lock and
+		 * wait for this timer with trigger_data->lock held, so never
+		 * spin on it here; a busy LED is updated on the next tick.
+		 */
+		if (!read_trylock(&trigger_data->lock))
+			continue;
+
+		netdev_trig_update(trigger_data, dev_stats);
+		trigger_data->next_update = jiffies + trigger_data->interval;
+		read_unlock(&trigger_data->lock);
+	}
+
+	if (time_after_eq(jiffies, sampler->rate_start + HZ)) {
+		sampler->rate = sampler->samples * HZ / (jiffies - sampler->rate_start);
+		sampler->rate_start = jiffies;
+		sampler->samples = 0;
+	}
+
+	mod_timer(&sampler->timer, netdev_trig_next_tick(sampler->interval));
 
 no_restart:
-	write_unlock(&trigger_data->lock);
+	spin_unlock(&netdev_trig_sampler_lock);
 }
 
 static void netdev_trig_activate(struct led_classdev *led_cdev)
@@ -353,7 +520,7 @@ static void netdev_trig_activate(struct led_classdev *led_cdev)
 	trigger_data->notifier.notifier_call = netdev_trig_notify;
 	trigger_data->notifier.priority = 10;
 
-	setup_timer(&trigger_data->timer, netdev_trig_timer, (unsigned long) trigger_data);
+	INIT_LIST_HEAD(&trigger_data->sampler_list);
 
 	trigger_data->led_cdev = led_cdev;
 	trigger_data->net_dev = NULL;
@@ -375,10 +542,15 @@ static void netdev_trig_activate(struct led_classdev *led_cdev)
 	rc = device_create_file(led_cdev->dev, &dev_attr_interval);
 	if (rc)
 		goto err_out_mode;
+	rc = device_create_file(led_cdev->dev, &dev_attr_stats_rate);
+	if (rc)
+		goto err_out_interval;
 
 	register_netdevice_notifier(&trigger_data->notifier);
 	return;
 
+err_out_interval:
+	device_remove_file(led_cdev->dev, &dev_attr_interval);
 err_out_mode:
 	device_remove_file(led_cdev->dev, &dev_attr_mode);
 err_out_device_name:
@@ -398,9 +570,12 @@ static void netdev_trig_deactivate(struct led_classdev *led_cdev)
 		device_remove_file(led_cdev->dev, &dev_attr_device_name);
 		device_remove_file(led_cdev->dev, &dev_attr_mode);
 		device_remove_file(led_cdev->dev, &dev_attr_interval);
+		device_remove_file(led_cdev->dev, &dev_attr_stats_rate);
 
 		write_lock(&trigger_data->lock);
 
+		netdev_trig_sampler_detach(trigger_data);
+
 		if (trigger_data->net_dev) {
 			dev_put(trigger_data->net_dev);
 			trigger_data->net_dev = NULL;
@@ -408,8 +583,6 @@ static void netdev_trig_deactivate(struct led_classdev *led_cdev)
 
 		write_unlock(&trigger_data->lock);
 
-		del_timer_sync(&trigger_data->timer);
-
 		kfree(trigger_data);
 	}
 }
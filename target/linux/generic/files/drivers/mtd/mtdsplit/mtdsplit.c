@@ -15,7 +15,11 @@
 #include <linux/export.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/magic.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
 #include <linux/byteorder/generic.h>
@@ -28,6 +32,137 @@ struct squashfs_super_block {
 	__le64 bytes_used;
 };
 
+/*
+ * Every parser looks for its header at the start of the erase blocks of
+ * the same partition, so the first bytes of each erase block are read
+ * only once while the parsers of a partition run and are shared by all
+ * of them. This must cover the largest header which is probed on erase
+ * block boundaries (the uImage header with its vendor prefix).
+ */
+#define MTD_SPLIT_PROBE_LEN	128
+
+struct mtd_split_probe {
+	struct mtd_info *mtd;
+	u_char **blocks;
+	unsigned int nr_blocks;
+
+	unsigned int reads;
+	unsigned int hits;
+	size_t read_bytes;
+	ktime_t start;
+};
+
+static DEFINE_MUTEX(probe_mutex);
+static struct mtd_split_probe probe;
+
+void mtd_split_probe_begin(struct mtd_info *mtd)
+{
+	mutex_lock(&probe_mutex);
+
+	memset(&probe, 0, sizeof(probe));
+	probe.mtd = mtd;
+	probe.start = ktime_get();
+
+	if (mtd->erasesize < MTD_SPLIT_PROBE_LEN)
+		return;
+
+	probe.nr_blocks = mtd_div_by_eb(mtd->size, mtd);
+	probe.blocks = vzalloc(probe.nr_blocks * sizeof(*probe.blocks));
+}
+EXPORT_SYMBOL_GPL(mtd_split_probe_begin);
+
+void mtd_split_probe_end(struct mtd_info *mtd)
+{
+	unsigned int i;
+
+	pr_info("probed \"%s\" with %u reads (%zu bytes), %u cached, in %lld us\n",
+		mtd->name, probe.reads, probe.read_bytes, probe.hits,
+		ktime_us_delta(ktime_get(), probe.start));
+
+	if (probe.blocks) {
+		for (i = 0; i < probe.nr_blocks; i++)
+			kfree(probe.blocks[i]);
+		vfree(probe.blocks);
+	}
+
+	memset(&probe, 0, sizeof(probe));
+	mutex_unlock(&probe_mutex);
+}
+EXPORT_SYMBOL_GPL(mtd_split_probe_end);
+
+static int mtd_split_read_direct(struct mtd_info *mtd, size_t offset,
+				 size_t len, void *buf)
+{
+	size_t retlen;
+	int err;
+
+	if (mtd == probe.mtd) {
+		probe.reads++;
+		probe.read_bytes += len;
+	}
+
+	err = mtd_read(mtd, offset, len, &retlen, buf);
+	pr_debug("read %zu bytes at 0x%zx from \"%s\": %d\n",
+		 len, offset, mtd->name, err);
+	if (err)
+		return err;
+
+	if (retlen != len)
+		return -EIO;
+
+	return 0;
+}
+
+/**
+ * mtd_split_read - read a header while the partition parsers run
+ *
+ * Reads which fit into the first MTD_SPLIT_PROBE_LEN bytes of an erase
+ * block are served from the probe cache, everything else goes to the
+ * flash. Returns 0 when all of @len bytes have been read.
+ */
+int mtd_split_read(struct mtd_info *mtd, size_t offset, size_t len,
+		   void *buf)
+{
+	unsigned int block;
+	size_t block_offset;
+	size_t eb_offset;
+	u_char *data;
+	int err;
+
+	if (mtd != probe.mtd || !probe.blocks || offset >= mtd->size)
+		return mtd_split_read_direct(mtd, offset, len, buf);
+
+	/* a partial erase block at the end is not cached */
+	block = mtd_div_by_eb(offset, mtd);
+	block_offset = mtd_mod_by_eb(offset, mtd);
+	if (block >= probe.nr_blocks ||
+	    block_offset + len > MTD_SPLIT_PROBE_LEN)
+		return mtd_split_read_direct(mtd, offset, len, buf);
+
+	data = probe.blocks[block];
+	if (!data) {
+		data = kmalloc(MTD_SPLIT_PROBE_LEN, GFP_KERNEL);
+		if (!data)
+			return mtd_split_read_direct(mtd, offset, len, buf);
+
+		eb_offset = offset - block_offset;
+		err = mtd_split_read_direct(mtd, eb_offset,
+					    MTD_SPLIT_PROBE_LEN, data);
+		if (err) {
+			kfree(data);
+			return err;
+		}
+
+		probe.blocks[block] = data;
+	} else {
+		probe.hits++;
+	}
+
+	memcpy(buf, data + block_offset, len);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mtd_split_read);
+
 int mtd_get_squashfs_len(struct mtd_info *master,
 			 size_t offset,
 			 size_t *squashfs_len)
@@ -36,8 +171,8 @@ int mtd_get_squashfs_len(struct mtd_info *master,
 	size_t retlen;
 	int err;
 
-	err = mtd_read(master, offset, sizeof(sb), &retlen, (void *)&sb);
-	if (err || (retlen != sizeof(sb))) {
+	err = mtd_split_read(master, offset, sizeof(sb), &sb);
+	if (err) {
 		pr_alert("error occured while reading from \"%s\"\n",
 			 master->name);
 		return -EIO;
@@ -73,17 +208,12 @@ static ssize_t mtd_next_eb(struct mtd_info *mtd, size_t offset)
 int mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset)
 {
 	u32 magic;
-	size_t retlen;
 	int ret;
 
-	ret = mtd_read(mtd, offset, sizeof(magic), &retlen,
-		       (unsigned char *) &magic);
+	ret = mtd_split_read(mtd, offset, sizeof(magic), &magic);
 	if (ret)
 		return ret;
 
-	if (retlen != sizeof(magic))
-		return -EIO;
-
 	if (le32_to_cpu(magic) != SQUASHFS_MAGIC &&
 	    magic != 0x19852003)
 		return -EINVAL;
@@ -19,6 +19,12 @@
 #define ROOTFS_SPLIT_NAME	"rootfs_data"
 
 #ifdef CONFIG_MTD_SPLIT
+void mtd_split_probe_begin(struct mtd_info *mtd);
+void mtd_split_probe_end(struct mtd_info *mtd);
+
+int mtd_split_read(struct mtd_info *mtd, size_t offset, size_t len,
+		   void *buf);
+
 int mtd_get_squashfs_len(struct mtd_info *master,
 			 size_t offset,
 			 size_t *squashfs_len);
@@ -31,6 +37,20 @@ int mtd_find_rootfs_from(struct mtd_info *mtd,
 			 size_t *ret_offset);
 
 #else
+static inline void mtd_split_probe_begin(struct mtd_info *mtd)
+{
+}
+
+static inline void mtd_split_probe_end(struct mtd_info *mtd)
+{
+}
+
+static inline int mtd_split_read(struct mtd_info *mtd, size_t offset,
+				 size_t len, void *buf)
+{
+	return -ENODEV;
+}
+
 static inline int mtd_get_squashfs_len(struct mtd_info *master,
 				       size_t offset,
 				       size_t *squashfs_len)
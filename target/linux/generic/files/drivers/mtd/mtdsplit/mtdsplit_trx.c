@@ -34,23 +34,14 @@ static int
 read_trx_header(struct mtd_info *mtd, size_t offset,
 		   struct trx_header *header)
 {
-	size_t header_len;
-	size_t retlen;
 	int ret;
 
-	header_len = sizeof(*header);
-	ret = mtd_read(mtd, offset, header_len, &retlen,
-		       (unsigned char *) header);
+	ret = mtd_split_read(mtd, offset, sizeof(*header), header);
 	if (ret) {
 		pr_debug("read error in \"%s\"\n", mtd->name);
 		return ret;
 	}
 
-	if (retlen != header_len) {
-		pr_debug("short read in \"%s\"\n", mtd->name);
-		return -EIO;
-	}
-
 	return 0;
 }
 
@@ -19,6 +19,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/delay.h>
+#include <linux/etherdevice.h>
 #include <linux/export.h>
 #include <linux/gpio.h>
 #include <linux/kernel.h>
@@ -32,6 +33,13 @@
 /* buffer size needed for displaying all MIBs with max'd values */
 #define B53_BUF_SIZE	1188
 
+/* ARL dumps have to fit into a single swconfig netlink message */
+#define B53_ARL_BUF_SIZE	3072
+#define B53_ARL_LINE_SIZE	32
+
+/* each search step returns up to two entries, bound the search by that */
+#define B53_ARL_SEARCH_STEPS	2048
+
 struct b53_mib_desc {
 	u8 size;
 	u8 offset;
@@ -360,6 +368,108 @@ static int b53_flush_arl(struct b53_device *dev)
 	return -EINVAL;
 }
 
+struct b53_arl_entry {
+	u8 mac[ETH_ALEN];
+	u16 vid;
+	u16 port;
+	unsigned is_valid:1;
+	unsigned is_static:1;
+};
+
+static int b53_arl_search_wait(struct b53_device *dev, u8 *ctl)
+{
+	unsigned int i;
+
+	/* a search step may take a while on a busy table, allow about 1s */
+	for (i = 0; i < 1000; i++) {
+		b53_read8(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_CTL, ctl);
+
+		/* either the search is done or there is a result to read */
+		if (!(*ctl & ARL_SRCH_STDN) || (*ctl & ARL_SRCH_VLID))
+			return 0;
+
+		usleep_range(1000, 2000);
+	}
+
+	return -ETIMEDOUT;
+}
+
+static void b53_arl_search_read(struct b53_device *dev, int idx,
+				struct b53_arl_entry *ent)
+{
+	u64 mac_vid;
+	u32 fwd_entry;
+	int i;
+
+	b53_read64(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_RSTL_MACVID(idx),
+		   &mac_vid);
+	b53_read32(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_RSTL(idx), &fwd_entry);
+
+	for (i = 0; i < ETH_ALEN; i++)
+		ent->mac[i] = (mac_vid >> (8 * (ETH_ALEN - 1 - i))) & 0xff;
+
+	ent->vid = (mac_vid >> ARLTBL_VID_S) & ARLTBL_VID_MASK;
+	ent->port = fwd_entry & ARLTBL_DATA_PORT_ID_MASK;
+	ent->is_valid = !!(fwd_entry & ARLTBL_VALID);
+	ent->is_static = !!(fwd_entry & ARLTBL_STATIC);
+}
+
+/*
+ * Walk the ARL table with the hardware search, one locked register
+ * access at a time so other users of the bus are not held off.
+ * Entries are printed one per line as "<mac> <vid> <port>[ s]", with
+ * "s" marking static entries. The first arl_skip entries are left out,
+ * so tables not fitting into one dump can be read in several parts.
+ */
+static int b53_arl_dump(struct b53_device *dev, char *buf, int size)
+{
+	struct b53_arl_entry ent;
+	unsigned long start = jiffies;
+	unsigned int skip = dev->arl_skip;
+	unsigned int entries = 0;
+	int steps, i, ret;
+	int len = 0;
+	u8 ctl;
+
+	buf[0] = 0;
+
+	b53_write8(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_CTL, ARL_SRCH_STDN);
+
+	for (steps = 0; steps < B53_ARL_SEARCH_STEPS; steps++) {
+		ret = b53_arl_search_wait(dev, &ctl);
+		if (ret)
+			return ret;
+
+		if (!(ctl & ARL_SRCH_STDN))
+			break;
+
+		for (i = 0; i < 2; i++) {
+			b53_arl_search_read(dev, i, &ent);
+			if (!ent.is_valid)
+				continue;
+
+			if (skip) {
+				skip--;
+				continue;
+			}
+
+			if (len + B53_ARL_LINE_SIZE > size)
+				goto out;
+
+			len += snprintf(buf + len, size - len, "%pM %u %u%s\n",
+					ent.mac, ent.vid, ent.port,
+					ent.is_static ? " s" : "");
+			entries++;
+		}
+	}
+
+out:
+	dev_dbg(dev->dev, "dumped %u ARL entries in %u ms\n", entries,
+		jiffies_to_msecs(jiffies - start));
+
+	return len;
+}
+
 static void b53_enable_ports(struct b53_device *dev)
 {
 	unsigned i;
@@ -867,16 +977,23 @@ static int b53_port_get_mib(struct switch_dev *sw_dev,
 
 	dev->buf[0] = 0;
 
+	/*
+	 * Keep the register lock for the whole page, so the page is selected
+	 * only once on buses remembering the current page.
+	 */
+	mutex_lock(&dev->reg_mutex);
+
 	for (; mibs->size > 0; mibs++) {
 		u64 val;
 
 		if (mibs->size == 8) {
-			b53_read64(dev, B53_MIB_PAGE(port), mibs->offset, &val);
+			dev->ops->read64(dev, B53_MIB_PAGE(port), mibs->offset,
+					 &val);
 		} else {
 			u32 val32;
 
-			b53_read32(dev, B53_MIB_PAGE(port), mibs->offset,
-				   &val32);
+			dev->ops->read32(dev, B53_MIB_PAGE(port), mibs->offset,
+					 &val32);
 			val = val32;
 		}
 
@@ -884,12 +1001,53 @@ static int b53_port_get_mib(struct switch_dev *sw_dev,
 				"%-20s: %llu\n", mibs->name, val);
 	}
 
+	mutex_unlock(&dev->reg_mutex);
+
 	val->len = len;
 	val->value.s = dev->buf;
 
 	return 0;
 }
 
+static int b53_global_get_arl_table(struct switch_dev *sw_dev,
+				    const struct switch_attr *attr,
+				    struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+	int len;
+
+	len = b53_arl_dump(dev, dev->arl_buf, B53_ARL_BUF_SIZE);
+	if (len < 0)
+		return len;
+
+	val->len = len;
+	val->value.s = dev->arl_buf;
+
+	return 0;
+}
+
+static int b53_global_get_arl_skip(struct switch_dev *dev,
+				   const struct switch_attr *attr,
+				   struct switch_val *val)
+{
+	struct b53_device *priv = sw_to_b53(dev);
+
+	val->value.i = priv->arl_skip;
+
+	return 0;
+}
+
+static int b53_global_set_arl_skip(struct switch_dev *dev,
+				   const struct switch_attr *attr,
+				   struct switch_val *val)
+{
+	struct b53_device *priv = sw_to_b53(dev);
+
+	priv->arl_skip = val->value.i;
+
+	return 0;
+}
+
 static struct switch_attr b53_global_ops_25[] = {
 	{
 		.type = SWITCH_TYPE_INT,
@@ -967,6 +1125,20 @@ static struct switch_attr b53_global_ops[] = {
 		.get = b53_global_get_4095_enable,
 		.max = 1,
 	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "arl_table",
+		.description = "Get ARL table entries (mac vid port [s])",
+		.get = b53_global_get_arl_table,
+	},
+	{
+		.type = SWITCH_TYPE_INT,
+		.name = "arl_skip",
+		.description = "Number of ARL entries to skip in arl_table",
+		.set = b53_global_set_arl_skip,
+		.get = b53_global_get_arl_skip,
+		.max = 4095,
+	},
 };
 
 static struct switch_attr b53_port_ops[] = {
@@ -1333,6 +1505,10 @@ static int b53_switch_init(struct b53_device *dev)
 	if (!dev->buf)
 		return -ENOMEM;
 
+	dev->arl_buf = devm_kzalloc(dev->dev, B53_ARL_BUF_SIZE, GFP_KERNEL);
+	if (!dev->arl_buf)
+		return -ENOMEM;
+
 	dev->reset_gpio = b53_switch_get_reset_gpio(dev);
 	if (dev->reset_gpio >= 0) {
 		ret = devm_gpio_request_one(dev->dev, dev->reset_gpio,
@@ -95,11 +95,13 @@ struct b53_device {
 	unsigned enable_vlan:1;
 	unsigned enable_jumbo:1;
 	unsigned allow_vid_4095:1;
+	unsigned arl_skip;
 
 	struct b53_port *ports;
 	struct b53_vlan *vlans;
 
 	char *buf;
+	char *arl_buf;
 };
 
 #define b53_for_each_port(dev, i) \
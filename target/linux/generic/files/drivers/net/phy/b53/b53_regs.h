@@ -193,6 +193,24 @@
  * ARL Access Page Registers
  *************************************************************************/
 
+/* ARL Search Control Register (8 bit) */
+#define B53_ARL_SRCH_CTL		0x50
+#define   ARL_SRCH_VLID			BIT(0)
+#define   ARL_SRCH_STDN			BIT(7)
+
+/* ARL Search MAC/VID Result Registers (64 bit) */
+#define B53_ARL_SRCH_RSTL_MACVID(i)	(0x60 + (i) * 0x10)
+#define   ARLTBL_MAC_MASK		0xffffffffffffULL
+#define   ARLTBL_VID_S			48
+#define   ARLTBL_VID_MASK		0xfff
+
+/* ARL Search Data Result Registers (32 bit) */
+#define B53_ARL_SRCH_RSTL(i)		(0x68 + (i) * 0x10)
+#define   ARLTBL_DATA_PORT_ID_MASK	0x1ff
+#define   ARLTBL_AGE			BIT(14)
+#define   ARLTBL_STATIC			BIT(15)
+#define   ARLTBL_VALID			BIT(16)
+
 /* VLAN Table Access Register (8 bit) */
 #define B53_VT_ACCESS			0x80
 #define B53_VT_ACCESS_9798		0x60 /* for BCM5397/BCM5398 */
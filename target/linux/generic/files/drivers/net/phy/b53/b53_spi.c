@@ -18,6 +18,7 @@
 
 #include <asm/unaligned.h>
 
+#include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/spi/spi.h>
@@ -38,25 +39,44 @@
 
 #define B53_SPI_PAGE_SELECT	0xff
 
-static inline int b53_spi_read_reg(struct spi_device *spi, u8 reg, u8 *val,
+struct b53_spi_priv {
+	struct spi_device *spi;
+	struct dentry *debugfs;
+	u32 transactions;
+};
+
+static inline int b53_spi_write(struct b53_device *dev, const u8 *buf,
+				unsigned len)
+{
+	struct b53_spi_priv *priv = dev->priv;
+
+	priv->transactions++;
+
+	return spi_write(priv->spi, buf, len);
+}
+
+static inline int b53_spi_read_reg(struct b53_device *dev, u8 reg, u8 *val,
 				     unsigned len)
 {
+	struct b53_spi_priv *priv = dev->priv;
 	u8 txbuf[2];
 
 	txbuf[0] = B53_SPI_CMD_NORMAL | B53_SPI_CMD_READ;
 	txbuf[1] = reg;
 
-	return spi_write_then_read(spi, txbuf, 2, val, len);
+	priv->transactions++;
+
+	return spi_write_then_read(priv->spi, txbuf, 2, val, len);
 }
 
-static inline int b53_spi_clear_status(struct spi_device *spi)
+static inline int b53_spi_clear_status(struct b53_device *dev)
 {
 	unsigned int i;
 	u8 rxbuf;
 	int ret;
 
 	for (i = 0; i < 10; i++) {
-		ret = b53_spi_read_reg(spi, B53_SPI_STATUS, &rxbuf, 1);
+		ret = b53_spi_read_reg(dev, B53_SPI_STATUS, &rxbuf, 1);
 		if (ret)
 			return ret;
 
@@ -72,39 +92,47 @@ static inline int b53_spi_clear_status(struct spi_device *spi)
 	return 0;
 }
 
-static inline int b53_spi_set_page(struct spi_device *spi, u8 page)
+static inline int b53_spi_set_page(struct b53_device *dev, u8 page)
 {
 	u8 txbuf[3];
+	int ret;
+
+	/* the page stays selected until it is changed, called with reg_mutex */
+	if (dev->current_page == page)
+		return 0;
 
 	txbuf[0] = B53_SPI_CMD_NORMAL | B53_SPI_CMD_WRITE;
 	txbuf[1] = B53_SPI_PAGE_SELECT;
 	txbuf[2] = page;
 
-	return spi_write(spi, txbuf, sizeof(txbuf));
+	ret = b53_spi_write(dev, txbuf, sizeof(txbuf));
+	dev->current_page = ret ? 0xff : page;
+
+	return ret;
 }
 
-static inline int b53_prepare_reg_access(struct spi_device *spi, u8 page)
+static inline int b53_prepare_reg_access(struct b53_device *dev, u8 page)
 {
-	int ret = b53_spi_clear_status(spi);
+	int ret = b53_spi_clear_status(dev);
 
 	if (ret)
 		return ret;
 
-	return b53_spi_set_page(spi, page);
+	return b53_spi_set_page(dev, page);
 }
 
-static int b53_spi_prepare_reg_read(struct spi_device *spi, u8 reg)
+static int b53_spi_prepare_reg_read(struct b53_device *dev, u8 reg)
 {
 	u8 rxbuf;
 	int retry_count;
 	int ret;
 
-	ret = b53_spi_read_reg(spi, reg, &rxbuf, 1);
+	ret = b53_spi_read_reg(dev, reg, &rxbuf, 1);
 	if (ret)
 		return ret;
 
 	for (retry_count = 0; retry_count < 10; retry_count++) {
-		ret = b53_spi_read_reg(spi, B53_SPI_STATUS, &rxbuf, 1);
+		ret = b53_spi_read_reg(dev, B53_SPI_STATUS, &rxbuf, 1);
 		if (ret)
 			return ret;
 
@@ -123,18 +151,17 @@ static int b53_spi_prepare_reg_read(struct spi_device *spi, u8 reg)
 static int b53_spi_read(struct b53_device *dev, u8 page, u8 reg, u8 *data,
 			unsigned len)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
-	ret = b53_spi_prepare_reg_read(spi, reg);
+	ret = b53_spi_prepare_reg_read(dev, reg);
 	if (ret)
 		return ret;
 
-	return b53_spi_read_reg(spi, B53_SPI_DATA, data, len);
+	return b53_spi_read_reg(dev, B53_SPI_DATA, data, len);
 }
 
 static int b53_spi_read8(struct b53_device *dev, u8 page, u8 reg, u8 *val)
@@ -186,11 +213,10 @@ static int b53_spi_read64(struct b53_device *dev, u8 page, u8 reg, u64 *val)
 
 static int b53_spi_write8(struct b53_device *dev, u8 page, u8 reg, u8 value)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 	u8 txbuf[3];
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
@@ -198,16 +224,15 @@ static int b53_spi_write8(struct b53_device *dev, u8 page, u8 reg, u8 value)
 	txbuf[1] = reg;
 	txbuf[2] = value;
 
-	return spi_write(spi, txbuf, sizeof(txbuf));
+	return b53_spi_write(dev, txbuf, sizeof(txbuf));
 }
 
 static int b53_spi_write16(struct b53_device *dev, u8 page, u8 reg, u16 value)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 	u8 txbuf[4];
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
@@ -215,16 +240,15 @@ static int b53_spi_write16(struct b53_device *dev, u8 page, u8 reg, u16 value)
 	txbuf[1] = reg;
 	put_unaligned_le16(value, &txbuf[2]);
 
-	return spi_write(spi, txbuf, sizeof(txbuf));
+	return b53_spi_write(dev, txbuf, sizeof(txbuf));
 }
 
 static int b53_spi_write32(struct b53_device *dev, u8 page, u8 reg, u32 value)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 	u8 txbuf[6];
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
@@ -232,16 +256,15 @@ static int b53_spi_write32(struct b53_device *dev, u8 page, u8 reg, u32 value)
 	txbuf[1] = reg;
 	put_unaligned_le32(value, &txbuf[2]);
 
-	return spi_write(spi, txbuf, sizeof(txbuf));
+	return b53_spi_write(dev, txbuf, sizeof(txbuf));
 }
 
 static int b53_spi_write48(struct b53_device *dev, u8 page, u8 reg, u64 value)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 	u8 txbuf[10];
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
@@ -249,16 +272,15 @@ static int b53_spi_write48(struct b53_device *dev, u8 page, u8 reg, u64 value)
 	txbuf[1] = reg;
 	put_unaligned_le64(value, &txbuf[2]);
 
-	return spi_write(spi, txbuf, sizeof(txbuf) - 2);
+	return b53_spi_write(dev, txbuf, sizeof(txbuf) - 2);
 }
 
 static int b53_spi_write64(struct b53_device *dev, u8 page, u8 reg, u64 value)
 {
-	struct spi_device *spi = dev->priv;
 	int ret;
 	u8 txbuf[10];
 
-	ret = b53_prepare_reg_access(spi, page);
+	ret = b53_prepare_reg_access(dev, page);
 	if (ret)
 		return ret;
 
@@ -266,7 +288,7 @@ static int b53_spi_write64(struct b53_device *dev, u8 page, u8 reg, u64 value)
 	txbuf[1] = reg;
 	put_unaligned_le64(value, &txbuf[2]);
 
-	return spi_write(spi, txbuf, sizeof(txbuf));
+	return b53_spi_write(dev, txbuf, sizeof(txbuf));
 }
 
 static struct b53_io_ops b53_spi_ops = {
@@ -284,13 +306,23 @@ static struct b53_io_ops b53_spi_ops = {
 
 static int b53_spi_probe(struct spi_device *spi)
 {
+	struct b53_spi_priv *priv;
 	struct b53_device *dev;
+	char name[32];
 	int ret;
 
-	dev = b53_switch_alloc(&spi->dev, &b53_spi_ops, spi);
+	priv = devm_kzalloc(&spi->dev, sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	priv->spi = spi;
+
+	dev = b53_switch_alloc(&spi->dev, &b53_spi_ops, priv);
 	if (!dev)
 		return -ENOMEM;
 
+	dev->current_page = 0xff;
+
 	if (spi->dev.platform_data)
 		dev->pdata = spi->dev.platform_data;
 
@@ -300,15 +332,26 @@ static int b53_spi_probe(struct spi_device *spi)
 
 	spi_set_drvdata(spi, dev);
 
+	/* number of SPI transfers issued, write 0 to reset */
+	snprintf(name, sizeof(name), "b53-%s", dev_name(&spi->dev));
+	priv->debugfs = debugfs_create_dir(name, NULL);
+	if (!IS_ERR_OR_NULL(priv->debugfs))
+		debugfs_create_u32("transactions", S_IRUGO | S_IWUSR,
+				   priv->debugfs, &priv->transactions);
+
 	return 0;
 }
 
 static int b53_spi_remove(struct spi_device *spi)
 {
 	struct b53_device *dev = spi_get_drvdata(spi);
+	struct b53_spi_priv *priv;
 
-	if (dev)
+	if (dev) {
+		priv = dev->priv;
+		debugfs_remove_recursive(priv->debugfs);
 		b53_switch_remove(dev);
+	}
 
 	return 0;
 }
@@ -18,6 +18,8 @@
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/of_gpio.h>
+#include <linux/of_mdio.h>
+#include <linux/ktime.h>
 #include <linux/rtl8366.h>
 
 #ifdef CONFIG_RTL8366_SMI_DEBUG_FS
@@ -31,6 +33,19 @@
 #define RTL8366_SMI_HW_STOP_DELAY		25	/* msecs */
 #define RTL8366_SMI_HW_START_DELAY		100	/* msecs */
 
+#define MDC_MDIO_CTRL0_REG		31
+#define MDC_MDIO_START_REG		29
+#define MDC_MDIO_CTRL1_REG		21
+#define MDC_MDIO_ADDRESS_REG		23
+#define MDC_MDIO_DATA_WRITE_REG		24
+#define MDC_MDIO_DATA_READ_REG		25
+
+#define MDC_MDIO_START_OP		0xFFFF
+#define MDC_MDIO_ADDR_OP		0x000E
+#define MDC_MDIO_READ_OP		0x0001
+#define MDC_MDIO_WRITE_OP		0x0003
+#define MDC_REALTEK_PHY_ADDR		0x0
+
 static inline void rtl8366_smi_clk_delay(struct rtl8366_smi *smi)
 {
 	ndelay(smi->clk_delay);
@@ -197,15 +212,13 @@ static int rtl8366_smi_read_byte1(struct rtl8366_smi *smi, u8 *data)
 	return 0;
 }
 
-int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
+/* must be called with smi->lock held */
+static int __rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
 {
-	unsigned long flags;
 	u8 lo = 0;
 	u8 hi = 0;
 	int ret;
 
-	spin_lock_irqsave(&smi->lock, flags);
-
 	rtl8366_smi_start(smi);
 
 	/* send READ command */
@@ -234,20 +247,16 @@ int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
 
  out:
 	rtl8366_smi_stop(smi);
-	spin_unlock_irqrestore(&smi->lock, flags);
 
 	return ret;
 }
-EXPORT_SYMBOL_GPL(rtl8366_smi_read_reg);
 
+/* must be called with smi->lock held */
 static int __rtl8366_smi_write_reg(struct rtl8366_smi *smi,
 				   u32 addr, u32 data, bool ack)
 {
-	unsigned long flags;
 	int ret;
 
-	spin_lock_irqsave(&smi->lock, flags);
-
 	rtl8366_smi_start(smi);
 
 	/* send WRITE command */
@@ -282,20 +291,224 @@ static int __rtl8366_smi_write_reg(struct rtl8366_smi *smi,
 
  out:
 	rtl8366_smi_stop(smi);
+
+	return ret;
+}
+
+/*
+ * Batches of consecutive registers are transferred with the lock held once.
+ * Interrupts stay disabled for the whole batch, so keep them short.
+ */
+static int __rtl8366_smi_read_regs(struct rtl8366_smi *smi, u32 addr,
+				   u32 *data, unsigned int count)
+{
+	unsigned long flags;
+	unsigned int i;
+	int ret = 0;
+
+	spin_lock_irqsave(&smi->lock, flags);
+	for (i = 0; i < count && !ret; i++)
+		ret = __rtl8366_smi_read_reg(smi, addr + i, &data[i]);
 	spin_unlock_irqrestore(&smi->lock, flags);
 
 	return ret;
 }
 
+static int __rtl8366_smi_write_regs(struct rtl8366_smi *smi, u32 addr,
+				    const u32 *data, unsigned int count,
+				    bool ack)
+{
+	unsigned long flags;
+	unsigned int i;
+	int ret = 0;
+
+	spin_lock_irqsave(&smi->lock, flags);
+	for (i = 0; i < count && !ret; i++)
+		ret = __rtl8366_smi_write_reg(smi, addr + i, data[i], ack);
+	spin_unlock_irqrestore(&smi->lock, flags);
+
+	return ret;
+}
+
+/*
+ * Chips which have their MDC/MDIO pins wired to a real MDIO controller can
+ * be accessed through an indirect register window on PHY address 0. This
+ * avoids bit-banging every transaction with interrupts disabled.
+ */
+/* must be called with the mdio_lock of the bus held */
+static int __rtl8366_mdio_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
+{
+	struct mii_bus *mbus = smi->ext_mbus;
+	u32 phy_id = MDC_REALTEK_PHY_ADDR;
+	int ret;
+
+	/* write address control code to register 31 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_CTRL0_REG, MDC_MDIO_ADDR_OP);
+
+	/* write address to register 23 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_ADDRESS_REG, addr);
+
+	/* write read control code to register 21 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_CTRL1_REG, MDC_MDIO_READ_OP);
+
+	/* read data from register 25 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	ret = mbus->read(mbus, phy_id, MDC_MDIO_DATA_READ_REG);
+	if (ret < 0)
+		return ret;
+
+	*data = ret;
+	return 0;
+}
+
+/* must be called with the mdio_lock of the bus held */
+static int __rtl8366_mdio_write_reg(struct rtl8366_smi *smi, u32 addr, u32 data)
+{
+	struct mii_bus *mbus = smi->ext_mbus;
+	u32 phy_id = MDC_REALTEK_PHY_ADDR;
+
+	/* write address control code to register 31 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_CTRL0_REG, MDC_MDIO_ADDR_OP);
+
+	/* write address to register 23 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_ADDRESS_REG, addr);
+
+	/* write data to register 24 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	mbus->write(mbus, phy_id, MDC_MDIO_DATA_WRITE_REG, data);
+
+	/* write write control code to register 21 */
+	mbus->write(mbus, phy_id, MDC_MDIO_START_REG, MDC_MDIO_START_OP);
+	return mbus->write(mbus, phy_id, MDC_MDIO_CTRL1_REG, MDC_MDIO_WRITE_OP);
+}
+
+static int __rtl8366_mdio_read_regs(struct rtl8366_smi *smi, u32 addr,
+				    u32 *data, unsigned int count)
+{
+	unsigned int i;
+	int ret = 0;
+
+	mutex_lock(&smi->ext_mbus->mdio_lock);
+	for (i = 0; i < count && !ret; i++)
+		ret = __rtl8366_mdio_read_reg(smi, addr + i, &data[i]);
+	mutex_unlock(&smi->ext_mbus->mdio_lock);
+
+	return ret;
+}
+
+static int __rtl8366_mdio_write_regs(struct rtl8366_smi *smi, u32 addr,
+				     const u32 *data, unsigned int count)
+{
+	unsigned int i;
+	int ret = 0;
+
+	mutex_lock(&smi->ext_mbus->mdio_lock);
+	for (i = 0; i < count && !ret; i++)
+		ret = __rtl8366_mdio_write_reg(smi, addr + i, data[i]);
+	mutex_unlock(&smi->ext_mbus->mdio_lock);
+
+	return ret;
+}
+
+#ifdef CONFIG_RTL8366_SMI_DEBUG_FS
+static inline ktime_t rtl8366_smi_xfer_begin(struct rtl8366_smi *smi)
+{
+	return ktime_get();
+}
+
+static void rtl8366_smi_xfer_end(struct rtl8366_smi *smi, ktime_t start,
+				 bool write, unsigned int count, int err)
+{
+	unsigned long flags;
+	u32 ns;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock_irqsave(&smi->lock, flags);
+	if (write)
+		smi->dbg_writes += count;
+	else
+		smi->dbg_reads += count;
+	if (err)
+		smi->dbg_errors++;
+	smi->dbg_xfer_ns += ns;
+	if (ns > smi->dbg_xfer_max_ns)
+		smi->dbg_xfer_max_ns = ns;
+	spin_unlock_irqrestore(&smi->lock, flags);
+}
+#else
+static inline ktime_t rtl8366_smi_xfer_begin(struct rtl8366_smi *smi)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void rtl8366_smi_xfer_end(struct rtl8366_smi *smi,
+					ktime_t start, bool write,
+					unsigned int count, int err)
+{
+}
+#endif
+
+int rtl8366_smi_read_regs(struct rtl8366_smi *smi, u32 addr, u32 *data,
+			  unsigned int count)
+{
+	ktime_t start = rtl8366_smi_xfer_begin(smi);
+	int err;
+
+	if (smi->ext_mbus)
+		err = __rtl8366_mdio_read_regs(smi, addr, data, count);
+	else
+		err = __rtl8366_smi_read_regs(smi, addr, data, count);
+
+	rtl8366_smi_xfer_end(smi, start, false, count, err);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(rtl8366_smi_read_regs);
+
+int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
+{
+	return rtl8366_smi_read_regs(smi, addr, data, 1);
+}
+EXPORT_SYMBOL_GPL(rtl8366_smi_read_reg);
+
+static int rtl8366_write_regs(struct rtl8366_smi *smi, u32 addr,
+			      const u32 *data, unsigned int count, bool ack)
+{
+	ktime_t start = rtl8366_smi_xfer_begin(smi);
+	int err;
+
+	if (smi->ext_mbus)
+		err = __rtl8366_mdio_write_regs(smi, addr, data, count);
+	else
+		err = __rtl8366_smi_write_regs(smi, addr, data, count, ack);
+
+	rtl8366_smi_xfer_end(smi, start, true, count, err);
+
+	return err;
+}
+
+int rtl8366_smi_write_regs(struct rtl8366_smi *smi, u32 addr, const u32 *data,
+			   unsigned int count)
+{
+	return rtl8366_write_regs(smi, addr, data, count, true);
+}
+EXPORT_SYMBOL_GPL(rtl8366_smi_write_regs);
+
 int rtl8366_smi_write_reg(struct rtl8366_smi *smi, u32 addr, u32 data)
 {
-	return __rtl8366_smi_write_reg(smi, addr, data, true);
+	return rtl8366_write_regs(smi, addr, &data, 1, true);
 }
 EXPORT_SYMBOL_GPL(rtl8366_smi_write_reg);
 
 int rtl8366_smi_write_reg_noack(struct rtl8366_smi *smi, u32 addr, u32 data)
 {
-	return __rtl8366_smi_write_reg(smi, addr, data, false);
+	return rtl8366_write_regs(smi, addr, &data, 1, false);
 }
 EXPORT_SYMBOL_GPL(rtl8366_smi_write_reg_noack);
 
@@ -798,6 +1011,70 @@ static ssize_t rtl8366_read_debugfs_mibs(struct file *file,
 	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
 }
 
+static ssize_t rtl8366_read_debugfs_xfer(struct file *file,
+					 char __user *user_buf,
+					 size_t count, loff_t *ppos)
+{
+	struct rtl8366_smi *smi = file->private_data;
+	char *buf = smi->buf;
+	unsigned long flags;
+	u32 reads, writes, errors, max_ns;
+	u64 avg_ns;
+	int len = 0;
+
+	spin_lock_irqsave(&smi->lock, flags);
+	reads = smi->dbg_reads;
+	writes = smi->dbg_writes;
+	errors = smi->dbg_errors;
+	avg_ns = smi->dbg_xfer_ns;
+	max_ns = smi->dbg_xfer_max_ns;
+	spin_unlock_irqrestore(&smi->lock, flags);
+
+	if (reads + writes)
+		do_div(avg_ns, reads + writes);
+
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"transport: %s\n", smi->ext_mbus ? "mdio" : "gpio");
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"reads:     %u\n", reads);
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"writes:    %u\n", writes);
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"errors:    %u\n", errors);
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"avg ns:    %llu\n", (unsigned long long) avg_ns);
+	len += snprintf(buf + len, sizeof(smi->buf) - len,
+			"max ns:    %u\n", max_ns);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static ssize_t rtl8366_write_debugfs_xfer(struct file *file,
+					  const char __user *user_buf,
+					  size_t count, loff_t *ppos)
+{
+	struct rtl8366_smi *smi = file->private_data;
+	unsigned long flags;
+
+	/* any write clears the statistics */
+	spin_lock_irqsave(&smi->lock, flags);
+	smi->dbg_reads = 0;
+	smi->dbg_writes = 0;
+	smi->dbg_errors = 0;
+	smi->dbg_xfer_ns = 0;
+	smi->dbg_xfer_max_ns = 0;
+	spin_unlock_irqrestore(&smi->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations fops_rtl8366_xfer = {
+	.read	= rtl8366_read_debugfs_xfer,
+	.write	= rtl8366_write_debugfs_xfer,
+	.open	= rtl8366_debugfs_open,
+	.owner	= THIS_MODULE
+};
+
 static const struct file_operations fops_rtl8366_regs = {
 	.read	= rtl8366_read_debugfs_reg,
 	.write	= rtl8366_write_debugfs_reg,
@@ -894,9 +1171,17 @@ static void rtl8366_debugfs_init(struct rtl8366_smi *smi)
 
 	node = debugfs_create_file("mibs", S_IRUSR, smi->debugfs_root, smi,
 				   &fops_rtl8366_mibs);
-	if (!node)
+	if (!node) {
 		dev_err(smi->parent, "Creating debugfs file '%s' failed\n",
 			"mibs");
+		return;
+	}
+
+	node = debugfs_create_file("xfer_stats", S_IRUSR | S_IWUSR, root, smi,
+				   &fops_rtl8366_xfer);
+	if (!node)
+		dev_err(smi->parent, "Creating debugfs file '%s' failed\n",
+			"xfer_stats");
 }
 
 static void rtl8366_debugfs_remove(struct rtl8366_smi *smi)
@@ -1237,6 +1522,9 @@ static int __rtl8366_smi_init(struct rtl8366_smi *smi, const char *name)
 {
 	int err;
 
+	if (smi->ext_mbus)
+		goto out_init;
+
 	err = gpio_request(smi->gpio_sda, name);
 	if (err) {
 		printk(KERN_ERR "rtl8366_smi: gpio_request failed for %u, err=%d\n",
@@ -1251,6 +1539,7 @@ static int __rtl8366_smi_init(struct rtl8366_smi *smi, const char *name)
 		goto err_free_sda;
 	}
 
+ out_init:
 	spin_lock_init(&smi->lock);
 
 	/* start the switch */
@@ -1272,6 +1561,11 @@ static void __rtl8366_smi_cleanup(struct rtl8366_smi *smi)
 	if (smi->hw_reset)
 		smi->hw_reset(true);
 
+	if (smi->ext_mbus) {
+		put_device(&smi->ext_mbus->dev);
+		return;
+	}
+
 	gpio_free(smi->gpio_sck);
 	gpio_free(smi->gpio_sda);
 }
@@ -1326,8 +1620,12 @@ int rtl8366_smi_init(struct rtl8366_smi *smi)
 	if (err)
 		goto err_out;
 
-	dev_info(smi->parent, "using GPIO pins %u (SDA) and %u (SCK)\n",
-		 smi->gpio_sda, smi->gpio_sck);
+	if (smi->ext_mbus)
+		dev_info(smi->parent, "using MDIO bus '%s'\n",
+			 smi->ext_mbus->name);
+	else
+		dev_info(smi->parent, "using GPIO pins %u (SDA) and %u (SCK)\n",
+			 smi->gpio_sda, smi->gpio_sck);
 
 	err = smi->ops->detect(smi);
 	if (err) {
@@ -1384,6 +1682,17 @@ int rtl8366_smi_probe_of(struct platform_device *pdev, struct rtl8366_smi *smi)
 {
 	int sck = of_get_named_gpio(pdev->dev.of_node, "gpio-sck", 0);
 	int sda = of_get_named_gpio(pdev->dev.of_node, "gpio-sda", 0);
+	struct device_node *np;
+
+	np = of_parse_phandle(pdev->dev.of_node, "mii-bus", 0);
+	if (np) {
+		smi->ext_mbus = of_mdio_find_bus(np);
+		of_node_put(np);
+		/* the MDIO bus driver may not have been probed yet */
+		if (!smi->ext_mbus)
+			return -EPROBE_DEFER;
+		return 0;
+	}
 
 	if (!gpio_is_valid(sck) || !gpio_is_valid(sda)) {
 		dev_err(&pdev->dev, "gpios missing in devictree\n");
@@ -1426,7 +1735,7 @@ struct rtl8366_smi *rtl8366_smi_probe(struct platform_device *pdev)
 
 	smi = rtl8366_smi_alloc(&pdev->dev);
 	if (!smi)
-		return NULL;
+		return ERR_PTR(-ENOMEM);
 
 	if (pdev->dev.of_node)
 		err = rtl8366_smi_probe_of(pdev, smi);
@@ -1440,7 +1749,7 @@ struct rtl8366_smi *rtl8366_smi_probe(struct platform_device *pdev)
 
 free_smi:
 	kfree(smi);
-	return NULL;
+	return ERR_PTR(err);
 }
 EXPORT_SYMBOL_GPL(rtl8366_smi_probe);
 
@@ -38,6 +38,7 @@ struct rtl8366_smi {
 	u8			cmd_read;
 	u8			cmd_write;
 	spinlock_t		lock;
+	struct mii_bus		*ext_mbus;	/* MDC/MDIO register access */
 	struct mii_bus		*mii_bus;
 	int			mii_irq[PHY_MAX_ADDR];
 	struct switch_dev	sw_dev;
@@ -58,6 +59,11 @@ struct rtl8366_smi {
 	struct dentry           *debugfs_root;
 	u16			dbg_reg;
 	u8			dbg_vlan_4k_page;
+	u32			dbg_reads;
+	u32			dbg_writes;
+	u32			dbg_errors;
+	u64			dbg_xfer_ns;
+	u32			dbg_xfer_max_ns;
 #endif
 };
 
@@ -108,6 +114,10 @@ void rtl8366_smi_cleanup(struct rtl8366_smi *smi);
 int rtl8366_smi_write_reg(struct rtl8366_smi *smi, u32 addr, u32 data);
 int rtl8366_smi_write_reg_noack(struct rtl8366_smi *smi, u32 addr, u32 data);
 int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data);
+int rtl8366_smi_read_regs(struct rtl8366_smi *smi, u32 addr, u32 *data,
+			  unsigned int count);
+int rtl8366_smi_write_regs(struct rtl8366_smi *smi, u32 addr, const u32 *data,
+			   unsigned int count);
 int rtl8366_smi_rmwr(struct rtl8366_smi *smi, u32 addr, u32 mask, u32 data);
 
 int rtl8366_reset_vlan(struct rtl8366_smi *smi);
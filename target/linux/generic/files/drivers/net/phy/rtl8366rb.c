@@ -424,7 +424,6 @@ static int rtl8366rb_get_vlan_4k(struct rtl8366_smi *smi, u32 vid,
 {
 	u32 data[3];
 	int err;
-	int i;
 
 	memset(vlan4k, '\0', sizeof(struct rtl8366_vlan_4k));
 
@@ -443,13 +442,10 @@ static int rtl8366rb_get_vlan_4k(struct rtl8366_smi *smi, u32 vid,
 	if (err)
 		return err;
 
-	for (i = 0; i < 3; i++) {
-		err = rtl8366_smi_read_reg(smi,
-					   RTL8366RB_VLAN_TABLE_READ_BASE + i,
-					   &data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_read_regs(smi, RTL8366RB_VLAN_TABLE_READ_BASE, data,
+				    ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	vlan4k->vid = vid;
 	vlan4k->untag = (data[1] >> RTL8366RB_VLAN_UNTAG_SHIFT) &
@@ -465,7 +461,6 @@ static int rtl8366rb_set_vlan_4k(struct rtl8366_smi *smi,
 {
 	u32 data[3];
 	int err;
-	int i;
 
 	if (vlan4k->vid >= RTL8366RB_NUM_VIDS ||
 	    vlan4k->member > RTL8366RB_VLAN_MEMBER_MASK ||
@@ -479,13 +474,10 @@ static int rtl8366rb_set_vlan_4k(struct rtl8366_smi *smi,
 			RTL8366RB_VLAN_UNTAG_SHIFT);
 	data[2] = vlan4k->fid & RTL8366RB_VLAN_FID_MASK;
 
-	for (i = 0; i < 3; i++) {
-		err = rtl8366_smi_write_reg(smi,
-					    RTL8366RB_VLAN_TABLE_WRITE_BASE + i,
-					    data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_write_regs(smi, RTL8366RB_VLAN_TABLE_WRITE_BASE, data,
+				     ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	/* write table access control word */
 	err = rtl8366_smi_write_reg(smi, RTL8366RB_TABLE_ACCESS_CTRL_REG,
@@ -499,20 +491,16 @@ static int rtl8366rb_get_vlan_mc(struct rtl8366_smi *smi, u32 index,
 {
 	u32 data[3];
 	int err;
-	int i;
 
 	memset(vlanmc, '\0', sizeof(struct rtl8366_vlan_mc));
 
 	if (index >= RTL8366RB_NUM_VLANS)
 		return -EINVAL;
 
-	for (i = 0; i < 3; i++) {
-		err = rtl8366_smi_read_reg(smi,
-					   RTL8366RB_VLAN_MC_BASE(index) + i,
-					   &data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_read_regs(smi, RTL8366RB_VLAN_MC_BASE(index), data,
+				    ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	vlanmc->vid = data[0] & RTL8366RB_VLAN_VID_MASK;
 	vlanmc->priority = (data[0] >> RTL8366RB_VLAN_PRIORITY_SHIFT) &
@@ -530,7 +518,6 @@ static int rtl8366rb_set_vlan_mc(struct rtl8366_smi *smi, u32 index,
 {
 	u32 data[3];
 	int err;
-	int i;
 
 	if (index >= RTL8366RB_NUM_VLANS ||
 	    vlanmc->vid >= RTL8366RB_NUM_VIDS ||
@@ -548,13 +535,10 @@ static int rtl8366rb_set_vlan_mc(struct rtl8366_smi *smi, u32 index,
 			RTL8366RB_VLAN_UNTAG_SHIFT);
 	data[2] = vlanmc->fid & RTL8366RB_VLAN_FID_MASK;
 
-	for (i = 0; i < 3; i++) {
-		err = rtl8366_smi_write_reg(smi,
-					    RTL8366RB_VLAN_MC_BASE(index) + i,
-					    data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_write_regs(smi, RTL8366RB_VLAN_MC_BASE(index), data,
+				     ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	return 0;
 }
@@ -1409,8 +1393,8 @@ static int rtl8366rb_probe(struct platform_device *pdev)
 		       " version " RTL8366RB_DRIVER_VER"\n");
 
 	smi = rtl8366_smi_probe(pdev);
-	if (!smi)
-		return -ENODEV;
+	if (IS_ERR(smi))
+		return PTR_ERR(smi);
 
 	smi->clk_delay = 10;
 	smi->cmd_read = 0xa9;
@@ -419,7 +419,6 @@ static int rtl8366s_get_vlan_4k(struct rtl8366_smi *smi, u32 vid,
 {
 	u32 data[2];
 	int err;
-	int i;
 
 	memset(vlan4k, '\0', sizeof(struct rtl8366_vlan_4k));
 
@@ -438,13 +437,10 @@ static int rtl8366s_get_vlan_4k(struct rtl8366_smi *smi, u32 vid,
 	if (err)
 		return err;
 
-	for (i = 0; i < 2; i++) {
-		err = rtl8366_smi_read_reg(smi,
-					   RTL8366S_VLAN_TABLE_READ_BASE + i,
-					   &data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_read_regs(smi, RTL8366S_VLAN_TABLE_READ_BASE, data,
+				    ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	vlan4k->vid = vid;
 	vlan4k->untag = (data[1] >> RTL8366S_VLAN_UNTAG_SHIFT) &
@@ -461,7 +457,6 @@ static int rtl8366s_set_vlan_4k(struct rtl8366_smi *smi,
 {
 	u32 data[2];
 	int err;
-	int i;
 
 	if (vlan4k->vid >= RTL8366S_NUM_VIDS ||
 	    vlan4k->member > RTL8366S_VLAN_MEMBER_MASK ||
@@ -476,13 +471,10 @@ static int rtl8366s_set_vlan_4k(struct rtl8366_smi *smi,
 		  ((vlan4k->fid & RTL8366S_VLAN_FID_MASK) <<
 			RTL8366S_VLAN_FID_SHIFT);
 
-	for (i = 0; i < 2; i++) {
-		err = rtl8366_smi_write_reg(smi,
-					    RTL8366S_VLAN_TABLE_WRITE_BASE + i,
-					    data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_write_regs(smi, RTL8366S_VLAN_TABLE_WRITE_BASE, data,
+				     ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	/* write table access control word */
 	err = rtl8366_smi_write_reg(smi, RTL8366S_TABLE_ACCESS_CTRL_REG,
@@ -496,20 +488,16 @@ static int rtl8366s_get_vlan_mc(struct rtl8366_smi *smi, u32 index,
 {
 	u32 data[2];
 	int err;
-	int i;
 
 	memset(vlanmc, '\0', sizeof(struct rtl8366_vlan_mc));
 
 	if (index >= RTL8366S_NUM_VLANS)
 		return -EINVAL;
 
-	for (i = 0; i < 2; i++) {
-		err = rtl8366_smi_read_reg(smi,
-					   RTL8366S_VLAN_MC_BASE(index) + i,
-					   &data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_read_regs(smi, RTL8366S_VLAN_MC_BASE(index), data,
+				    ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	vlanmc->vid = data[0] & RTL8366S_VLAN_VID_MASK;
 	vlanmc->priority = (data[0] >> RTL8366S_VLAN_PRIORITY_SHIFT) &
@@ -528,7 +516,6 @@ static int rtl8366s_set_vlan_mc(struct rtl8366_smi *smi, u32 index,
 {
 	u32 data[2];
 	int err;
-	int i;
 
 	if (index >= RTL8366S_NUM_VLANS ||
 	    vlanmc->vid >= RTL8366S_NUM_VIDS ||
@@ -547,13 +534,10 @@ static int rtl8366s_set_vlan_mc(struct rtl8366_smi *smi, u32 index,
 		  ((vlanmc->fid & RTL8366S_VLAN_FID_MASK) <<
 			RTL8366S_VLAN_FID_SHIFT);
 
-	for (i = 0; i < 2; i++) {
-		err = rtl8366_smi_write_reg(smi,
-					    RTL8366S_VLAN_MC_BASE(index) + i,
-					    data[i]);
-		if (err)
-			return err;
-	}
+	err = rtl8366_smi_write_regs(smi, RTL8366S_VLAN_MC_BASE(index), data,
+				     ARRAY_SIZE(data));
+	if (err)
+		return err;
 
 	return 0;
 }
@@ -1061,8 +1045,8 @@ static int rtl8366s_probe(struct platform_device *pdev)
 		       " version " RTL8366S_DRIVER_VER"\n");
 
 	smi = rtl8366_smi_probe(pdev);
-	if (!smi)
-		return -ENODEV;
+	if (IS_ERR(smi))
+		return PTR_ERR(smi);
 
 	smi->clk_delay = 10;
 	smi->cmd_read = 0xa9;
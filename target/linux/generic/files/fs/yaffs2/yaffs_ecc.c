@@ -68,6 +68,61 @@ static const unsigned char column_parity_table[] = {
 };
 
 
+static inline unsigned char yaffs_ecc_parity(u32 v)
+{
+	v ^= v >> 16;
+	v ^= v >> 8;
+	return column_parity_table[v & 0xff] & 0x01;
+}
+
+/*
+ * Calculate the line and column parities of an aligned 256-byte block one
+ * 32-bit word at a time.
+ * Bits 2..7 of the line parity are the word index, so they are the parities
+ * of the XOR of all words whose index has that bit set. Bits 0..1 are the
+ * byte position within a word and, together with the column parity, follow
+ * from the bytes of the XOR of all words.
+ */
+static void yaffs_ecc_calc_words(const u32 *data, unsigned char *col_parity,
+				 unsigned char *line_parity,
+				 unsigned char *line_parity_prime)
+{
+	unsigned int i;
+	u32 w, sum = 0;
+	u32 rp[6] = { 0 };
+	unsigned char lane[4];
+	unsigned char lp;
+
+	/* Four words per round, so only the group index needs tests */
+	for (i = 0; i < 16; i++, data += 4) {
+		rp[0] ^= data[1] ^ data[3];
+		rp[1] ^= data[2] ^ data[3];
+		w = data[0] ^ data[1] ^ data[2] ^ data[3];
+		sum ^= w;
+		if (i & 0x01)
+			rp[2] ^= w;
+		if (i & 0x02)
+			rp[3] ^= w;
+		if (i & 0x04)
+			rp[4] ^= w;
+		if (i & 0x08)
+			rp[5] ^= w;
+	}
+
+	memcpy(lane, &sum, sizeof(lane));
+	*col_parity = column_parity_table[lane[0] ^ lane[1] ^
+					  lane[2] ^ lane[3]];
+
+	lp = yaffs_ecc_parity(lane[1] ^ lane[3]);
+	lp |= yaffs_ecc_parity(lane[2] ^ lane[3]) << 1;
+	for (i = 0; i < 6; i++)
+		lp |= yaffs_ecc_parity(rp[i]) << (i + 2);
+
+	/* An odd number of odd bytes flips every bit of the primed parity */
+	*line_parity = lp;
+	*line_parity_prime = (*col_parity & 0x01) ? ~lp : lp;
+}
+
 /* Calculate the ECC for a 256-byte block of data */
 void yaffs_ecc_calc(const unsigned char *data, unsigned char *ecc)
 {
@@ -78,13 +133,18 @@ void yaffs_ecc_calc(const unsigned char *data, unsigned char *ecc)
 	unsigned char t;
 	unsigned char b;
 
-	for (i = 0; i < 256; i++) {
-		b = column_parity_table[*data++];
-		col_parity ^= b;
-
-		if (b & 0x01) {	/* odd number of bits in the byte */
-			line_parity ^= i;
-			line_parity_prime ^= ~i;
+	if (!((unsigned long)data & 3)) {
+		yaffs_ecc_calc_words((const u32 *)data, &col_parity,
+				     &line_parity, &line_parity_prime);
+	} else {
+		for (i = 0; i < 256; i++) {
+			b = column_parity_table[*data++];
+			col_parity ^= b;
+
+			if (b & 0x01) {	/* odd number of bits in the byte */
+				line_parity ^= i;
+				line_parity_prime ^= ~i;
+			}
 		}
 	}
 
@@ -80,28 +80,29 @@ static __inline__ void blast_dcache(unsigned long size, unsigned long lsize)
 
 unsigned char *data;
 
-static int read_byte(void *object, unsigned char **buffer, UInt32 *bufferSize)
+extern char lzma_start[];
+extern char lzma_end[];
+
+/* hand the decoder the rest of the stream in one go instead of calling
+ * back for every single byte
+ */
+static int read_data(void *object, unsigned char **buffer, UInt32 *bufferSize)
 {
-	*bufferSize = 1;
 	*buffer = data;
-	++data;
+	*bufferSize = (unsigned char *)lzma_end - data;
+	data += *bufferSize;
 	return LZMA_RESULT_OK;
 }
 
 static __inline__ unsigned char get_byte(void)
 {
-	unsigned char *buffer;
-	UInt32 fake;
-	
-	return read_byte(0, &buffer, &fake), *buffer;
+	return *data++;
 }
 
 /* This puts lzma workspace 128k below RAM end. 
  * That should be enough for both lzma and stack
  */
 static char *buffer = (char *)(RAMSTART + RAMSIZE - 0x00020000);
-extern char lzma_start[];
-extern char lzma_end[];
 
 /* should be the first function */
 void entry(unsigned long icache_size, unsigned long icache_lsize, 
@@ -119,7 +120,7 @@ void entry(unsigned long icache_size, unsigned long icache_lsize,
 
 	ILzmaInCallback callback;
 	CLzmaDecoderState vs;
-	callback.Read = read_byte;
+	callback.Read = read_data;
 
 	data = lzma_start;
 
@@ -163,20 +163,69 @@ static void fe_get_ringparam(struct net_device *dev,
 	ring->tx_pending = priv->tx_ring_size;
 }
 
+static int fe_get_coalesce(struct net_device *dev,
+		struct ethtool_coalesce *ec)
+{
+	struct fe_priv *priv = netdev_priv(dev);
+
+	ec->rx_coalesce_usecs = priv->coalesce_usecs;
+	ec->tx_coalesce_usecs = priv->coalesce_usecs;
+	ec->use_adaptive_rx_coalesce = priv->coalesce_adaptive;
+
+	return 0;
+}
+
+static int fe_set_coalesce(struct net_device *dev,
+		struct ethtool_coalesce *ec)
+{
+	struct fe_priv *priv = netdev_priv(dev);
+	unsigned int usecs = ec->rx_coalesce_usecs;
+
+	/* RX and TX completions share one poll run, so one value for both */
+	if (ec->rx_coalesce_usecs != ec->tx_coalesce_usecs ||
+	    usecs > FE_COALESCE_MAX_USECS)
+		return -EINVAL;
+
+	if (usecs && usecs < FE_COALESCE_MIN_USECS)
+		usecs = FE_COALESCE_MIN_USECS;
+
+	priv->coalesce_usecs = usecs;
+	priv->coalesce_cur_usecs = usecs;
+	priv->coalesce_adaptive = !!ec->use_adaptive_rx_coalesce;
+
+	return 0;
+}
+
+static const char fe_rx_str[][ETH_GSTRING_LEN] = {
+#define _FE(x...)	# x,
+FE_RX_STAT_DECLARE
+#undef _FE
+};
+
 static void fe_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 {
+	struct fe_priv *priv = netdev_priv(dev);
+
 	switch (stringset) {
 	case ETH_SS_STATS:
-		memcpy(data, *fe_gdma_str, sizeof(fe_gdma_str));
+		if (priv->hw_stats) {
+			memcpy(data, *fe_gdma_str, sizeof(fe_gdma_str));
+			data += sizeof(fe_gdma_str);
+		}
+		memcpy(data, *fe_rx_str, sizeof(fe_rx_str));
 		break;
 	}
 }
 
 static int fe_get_sset_count(struct net_device *dev, int sset)
 {
+	struct fe_priv *priv = netdev_priv(dev);
+
 	switch (sset) {
 	case ETH_SS_STATS:
-		return ARRAY_SIZE(fe_gdma_str);
+		if (priv->hw_stats)
+			return ARRAY_SIZE(fe_gdma_str) + ARRAY_SIZE(fe_rx_str);
+		return ARRAY_SIZE(fe_rx_str);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -187,26 +236,41 @@ static void fe_get_ethtool_stats(struct net_device *dev,
 {
 	struct fe_priv *priv = netdev_priv(dev);
 	struct fe_hw_stats *hwstats = priv->hw_stats;
+	struct fe_rx_stats *rxstats = &priv->rx_stats;
 	u64 *data_src, *data_dst;
 	unsigned int start;
 	int i;
 
-	if (netif_running(dev) && netif_device_present(dev)) {
-		if (spin_trylock(&hwstats->stats_lock)) {
-			fe_stats_update(priv);
-			spin_unlock(&hwstats->stats_lock);
+	if (hwstats) {
+		if (netif_running(dev) && netif_device_present(dev)) {
+			if (spin_trylock(&hwstats->stats_lock)) {
+				fe_stats_update(priv);
+				spin_unlock(&hwstats->stats_lock);
+			}
 		}
+
+		do {
+			data_src = &hwstats->tx_bytes;
+			data_dst = data;
+			start = u64_stats_fetch_begin_irq(&hwstats->syncp);
+
+			for (i = 0; i < ARRAY_SIZE(fe_gdma_str); i++)
+				*data_dst++ = *data_src++;
+
+		} while (u64_stats_fetch_retry_irq(&hwstats->syncp, start));
+
+		data += ARRAY_SIZE(fe_gdma_str);
 	}
 
 	do {
-		data_src = &hwstats->tx_bytes;
+		data_src = &rxstats->rx_frag_alloc;
 		data_dst = data;
-		start = u64_stats_fetch_begin_irq(&hwstats->syncp);
+		start = u64_stats_fetch_begin_irq(&rxstats->syncp);
 
-		for (i = 0; i < ARRAY_SIZE(fe_gdma_str); i++)
+		for (i = 0; i < ARRAY_SIZE(fe_rx_str); i++)
 			*data_dst++ = *data_src++;
 
-	} while (u64_stats_fetch_retry_irq(&hwstats->syncp, start));
+	} while (u64_stats_fetch_retry_irq(&rxstats->syncp, start));
 }
 
 static struct ethtool_ops fe_ethtool_ops = {
@@ -219,18 +283,14 @@ static struct ethtool_ops fe_ethtool_ops = {
 	.get_link		= fe_get_link,
 	.set_ringparam		= fe_set_ringparam,
 	.get_ringparam		= fe_get_ringparam,
+	.get_coalesce		= fe_get_coalesce,
+	.set_coalesce		= fe_set_coalesce,
+	.get_strings		= fe_get_strings,
+	.get_sset_count		= fe_get_sset_count,
+	.get_ethtool_stats	= fe_get_ethtool_stats,
 };
 
 void fe_set_ethtool_ops(struct net_device *netdev)
 {
-	struct fe_priv *priv = netdev_priv(netdev);
-	struct fe_soc_data *soc = priv->soc;
-
-	if (soc->reg_table[FE_REG_FE_COUNTER_BASE]) {
-		fe_ethtool_ops.get_strings = fe_get_strings;
-		fe_ethtool_ops.get_sset_count = fe_get_sset_count;
-		fe_ethtool_ops.get_ethtool_stats = fe_get_ethtool_stats;
-	}
-
 	netdev->ethtool_ops = &fe_ethtool_ops;
 }
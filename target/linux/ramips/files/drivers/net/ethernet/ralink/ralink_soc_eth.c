@@ -44,6 +44,7 @@
 #define FE_RX_HLEN		(NET_SKB_PAD + VLAN_ETH_HLEN + VLAN_HLEN + \
 		+ NET_IP_ALIGN + ETH_FCS_LEN)
 #define DMA_DUMMY_DESC		0xffffffff
+#define FE_RX_COPYBREAK		256
 #define FE_DEFAULT_MSG_ENABLE    \
         (NETIF_MSG_DRV      | \
          NETIF_MSG_PROBE    | \
@@ -771,11 +772,33 @@ static inline void fe_rx_vlan(struct sk_buff *skb)
 	}
 }
 
+static struct sk_buff *fe_rx_copy(struct fe_priv *priv, u8 *data,
+		dma_addr_t dma_addr, unsigned int pktlen, int pad)
+{
+	struct net_device *netdev = priv->netdev;
+	unsigned int len = pktlen + NET_IP_ALIGN - pad;
+	struct sk_buff *skb;
+
+	skb = netdev_alloc_skb_ip_align(netdev, pktlen);
+	if (unlikely(!skb))
+		return NULL;
+
+	/* the buffer stays mapped and goes straight back to the ring */
+	dma_sync_single_for_cpu(&netdev->dev, dma_addr, len, DMA_FROM_DEVICE);
+	memcpy(skb_put(skb, pktlen), data + NET_SKB_PAD + NET_IP_ALIGN,
+			pktlen);
+	dma_sync_single_for_device(&netdev->dev, dma_addr, len,
+			DMA_FROM_DEVICE);
+
+	return skb;
+}
+
 static int fe_poll_rx(struct napi_struct *napi, int budget,
 		struct fe_priv *priv, u32 rx_intr)
 {
 	struct net_device *netdev = priv->netdev;
 	struct net_device_stats *stats = &netdev->stats;
+	struct fe_rx_stats *rx_stats = &priv->rx_stats;
 	struct fe_soc_data *soc = priv->soc;
 	u32 checksum_bit;
 	int idx = fe_reg_r32(FE_REG_RX_CALC_IDX0);
@@ -783,6 +806,7 @@ static int fe_poll_rx(struct napi_struct *napi, int budget,
 	u8 *data, *new_data;
 	struct fe_rx_dma *rxd, trxd;
 	int done = 0, pad;
+	unsigned int allocated = 0, recycled = 0, dropped = 0;
 	bool rx_vlan = netdev->features & NETIF_F_HW_VLAN_CTAG_RX;
 
 	if (netdev->features & NETIF_F_RXCSUM)
@@ -806,34 +830,50 @@ static int fe_poll_rx(struct napi_struct *napi, int budget,
 		if (!(trxd.rxd2 & RX_DMA_DONE))
 			break;
 
+		pktlen = RX_DMA_PLEN0(trxd.rxd2);
+
+		/* copy small frames and recycle their buffer */
+		if (pktlen <= FE_RX_COPYBREAK) {
+			skb = fe_rx_copy(priv, data, trxd.rxd1, pktlen, pad);
+			if (unlikely(!skb))
+				goto drop_desc;
+			recycled++;
+			goto receive;
+		}
+
 		/* alloc new buffer */
 		new_data = netdev_alloc_frag(priv->frag_size);
-		if (unlikely(!new_data)) {
-			stats->rx_dropped++;
-			goto release_desc;
-		}
+		if (unlikely(!new_data))
+			goto drop_desc;
 		dma_addr = dma_map_single(&netdev->dev,
 				new_data + NET_SKB_PAD + pad,
 				priv->rx_buf_size,
 				DMA_FROM_DEVICE);
 		if (unlikely(dma_mapping_error(&netdev->dev, dma_addr))) {
 			put_page(virt_to_head_page(new_data));
-			goto release_desc;
+			goto drop_desc;
 		}
 
 		/* receive data */
 		skb = build_skb(data, priv->frag_size);
 		if (unlikely(!skb)) {
+			dma_unmap_single(&netdev->dev, dma_addr,
+					priv->rx_buf_size, DMA_FROM_DEVICE);
 			put_page(virt_to_head_page(new_data));
-			goto release_desc;
+			goto drop_desc;
 		}
 		skb_reserve(skb, NET_SKB_PAD + NET_IP_ALIGN);
 
 		dma_unmap_single(&netdev->dev, trxd.rxd1,
 				priv->rx_buf_size, DMA_FROM_DEVICE);
-		pktlen = RX_DMA_PLEN0(trxd.rxd2);
-		skb->dev = netdev;
 		skb_put(skb, pktlen);
+
+		priv->rx_data[idx] = new_data;
+		rxd->rxd1 = (unsigned int) dma_addr;
+		allocated++;
+
+receive:
+		skb->dev = netdev;
 		if (trxd.rxd4 & checksum_bit) {
 			skb->ip_summed = CHECKSUM_UNNECESSARY;
 		} else {
@@ -847,9 +887,11 @@ static int fe_poll_rx(struct napi_struct *napi, int budget,
 		stats->rx_bytes += pktlen;
 
 		napi_gro_receive(napi, skb);
+		goto release_desc;
 
-		priv->rx_data[idx] = new_data;
-		rxd->rxd1 = (unsigned int) dma_addr;
+drop_desc:
+		stats->rx_dropped++;
+		dropped++;
 
 release_desc:
 		if (priv->flags & FE_FLAG_RX_SG_DMA)
@@ -862,6 +904,14 @@ release_desc:
 		done++;
 	}
 
+	if (done) {
+		u64_stats_update_begin(&rx_stats->syncp);
+		rx_stats->rx_frag_alloc += allocated;
+		rx_stats->rx_frag_recycle += recycled;
+		rx_stats->rx_frag_drop += dropped;
+		u64_stats_update_end(&rx_stats->syncp);
+	}
+
 	if (done < budget)
 		fe_reg_w32(rx_intr, FE_REG_FE_INT_STATUS);
 
@@ -918,6 +968,44 @@ txpoll_again:
 	return done;
 }
 
+static enum hrtimer_restart fe_coalesce_timer_handler(struct hrtimer *t)
+{
+	struct fe_priv *priv = container_of(t, struct fe_priv, coalesce_timer);
+
+	napi_schedule(&priv->rx_napi);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Software interrupt moderation: keep the interrupts masked and poll
+ * again after the coalesce delay as long as the poll runs find work to
+ * do. The adaptive mode scales the delay towards half a budget per run
+ * and falls back to interrupts at low packet rates.
+ */
+static bool fe_coalesce_rearm(struct fe_priv *priv, int done, int budget)
+{
+	unsigned int usecs = priv->coalesce_usecs;
+
+	if (!usecs || !done)
+		return false;
+
+	if (priv->coalesce_adaptive) {
+		if (done < budget / 8)
+			return false;
+
+		usecs = priv->coalesce_cur_usecs * (budget / 2) / done;
+		usecs = clamp_t(unsigned int, usecs, FE_COALESCE_MIN_USECS,
+				priv->coalesce_usecs);
+		priv->coalesce_cur_usecs = usecs;
+	}
+
+	hrtimer_start(&priv->coalesce_timer,
+			ns_to_ktime(usecs * NSEC_PER_USEC), HRTIMER_MODE_REL);
+
+	return true;
+}
+
 static int fe_poll(struct napi_struct *napi, int budget)
 {
 	struct fe_priv *priv = container_of(napi, struct fe_priv, rx_napi);
@@ -965,7 +1053,8 @@ static int fe_poll(struct napi_struct *napi, int budget)
 			goto poll_again;
 
 		napi_complete(napi);
-		fe_int_enable(tx_intr | rx_intr);
+		if (!fe_coalesce_rearm(priv, tx_done + rx_done, budget))
+			fe_int_enable(tx_intr | rx_intr);
 	}
 
 poll_again:
@@ -1094,6 +1183,24 @@ static void fe_txcsum_config(bool enable)
 				FE_CDMA_CSG_CFG);
 }
 
+static int fe_set_features(struct net_device *dev,
+		netdev_features_t features)
+{
+	struct fe_priv *priv = netdev_priv(dev);
+	netdev_features_t changed = dev->features ^ features;
+
+	if (changed & NETIF_F_RXCSUM) {
+		bool enable = !!(features & NETIF_F_RXCSUM);
+
+		if (priv->soc->rxcsum_config)
+			priv->soc->rxcsum_config(enable);
+		else
+			fe_rxcsum_config(enable);
+	}
+
+	return 0;
+}
+
 void fe_csum_config(struct fe_priv *priv)
 {
 	struct net_device *dev = priv_netdev(priv);
@@ -1194,6 +1301,7 @@ static int fe_stop(struct net_device *dev)
 
 	spin_lock_irqsave(&priv->page_lock, flags);
 	napi_disable(&priv->rx_napi);
+	hrtimer_cancel(&priv->coalesce_timer);
 
 	fe_reg_w32(fe_reg_r32(FE_REG_PDMA_GLO_CFG) &
 		     ~(FE_TX_WB_DDONE | FE_RX_DMA_EN | FE_TX_DMA_EN),
@@ -1358,6 +1466,7 @@ static const struct net_device_ops fe_netdev_ops = {
 	.ndo_change_mtu		= fe_change_mtu,
 	.ndo_tx_timeout		= fe_tx_timeout,
 	.ndo_get_stats64        = fe_get_stats64,
+	.ndo_set_features	= fe_set_features,
 	.ndo_vlan_rx_add_vid	= fe_vlan_rx_add_vid,
 	.ndo_vlan_rx_kill_vid	= fe_vlan_rx_kill_vid,
 #ifdef CONFIG_NET_POLL_CONTROLLER
@@ -1462,6 +1571,7 @@ static int fe_probe(struct platform_device *pdev)
 
 	priv = netdev_priv(netdev);
 	spin_lock_init(&priv->page_lock);
+	u64_stats_init(&priv->rx_stats.syncp);
 	if (fe_reg_table[FE_REG_FE_COUNTER_BASE]) {
 		priv->hw_stats = kzalloc(sizeof(*priv->hw_stats), GFP_KERNEL);
 		if (!priv->hw_stats) {
@@ -1491,6 +1601,8 @@ static int fe_probe(struct platform_device *pdev)
 		priv->rx_ring_size *= 4;
 	}
 	netif_napi_add(netdev, &priv->rx_napi, fe_poll, napi_weight);
+	hrtimer_init(&priv->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	priv->coalesce_timer.function = fe_coalesce_timer_handler;
 	fe_set_ethtool_ops(netdev);
 
 	err = register_netdev(netdev);
@@ -26,6 +26,7 @@
 #include <linux/phy.h>
 #include <linux/ethtool.h>
 #include <linux/version.h>
+#include <linux/hrtimer.h>
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,15,0)
 #define u64_stats_fetch_retry_irq u64_stats_fetch_retry_bh
@@ -64,6 +65,9 @@ enum fe_work_flag {
 #define NUM_DMA_DESC		(1 << 7)
 #define MAX_DMA_DESC		0xfff
 
+#define FE_COALESCE_MAX_USECS	1000
+#define FE_COALESCE_MIN_USECS	10
+
 #define FE_DELAY_EN_INT		0x80
 #define FE_DELAY_MAX_INT	0x04
 #define FE_DELAY_MAX_TOUT	0x04
@@ -389,6 +393,7 @@ struct fe_soc_data
 	void (*set_mac)(struct fe_priv *priv, unsigned char *mac);
 	int (*fwd_config)(struct fe_priv *priv);
 	void (*tx_dma)(struct fe_tx_dma *txd);
+	void (*rxcsum_config)(bool enable);
 	int (*switch_init)(struct fe_priv *priv);
 	int (*switch_config)(struct fe_priv *priv);
 	void (*port_init)(struct fe_priv *priv, struct device_node *port);
@@ -438,6 +443,19 @@ FE_STAT_REG_DECLARE
 #undef _FE
 };
 
+#define FE_RX_STAT_DECLARE		\
+	_FE(rx_frag_alloc)		\
+	_FE(rx_frag_recycle)		\
+	_FE(rx_frag_drop)
+
+struct fe_rx_stats
+{
+	struct u64_stats_sync syncp;
+#define _FE(x) u64 x;
+FE_RX_STAT_DECLARE
+#undef _FE
+};
+
 enum fe_tx_flags {
 	FE_TX_FLAGS_SINGLE0	= 0x01,
 	FE_TX_FLAGS_PAGE0	= 0x02,
@@ -473,6 +491,11 @@ struct fe_priv
 	dma_addr_t			rx_phys;
 	struct napi_struct		rx_napi;
 
+	struct hrtimer			coalesce_timer;
+	unsigned int			coalesce_usecs;
+	unsigned int			coalesce_cur_usecs;
+	bool				coalesce_adaptive;
+
 	struct fe_tx_dma		*tx_dma;
 	struct fe_tx_buf		*tx_buf;
 	dma_addr_t			tx_phys;
@@ -486,6 +509,7 @@ struct fe_priv
 	int				link[8];
 
 	struct fe_hw_stats		*hw_stats;
+	struct fe_rx_stats		rx_stats;
 	unsigned long			vlan_map;
 	struct work_struct		pending_work;
 	DECLARE_BITMAP(pending_flags, FE_FLAG_MAX);
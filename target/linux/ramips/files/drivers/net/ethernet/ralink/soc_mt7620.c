@@ -234,6 +234,7 @@ static struct fe_soc_data mt7620_data = {
 	.set_mac = mt7620_set_mac,
 	.fwd_config = mt7620_fwd_config,
 	.tx_dma = mt7620_tx_dma,
+	.rxcsum_config = mt7620_rxcsum_config,
 	.switch_init = mt7620_gsw_probe,
 	.switch_config = mt7620_gsw_config,
 	.port_init = mt7620_port_init,
@@ -255,6 +256,7 @@ static struct fe_soc_data mt7621_data = {
 	.set_mac = mt7621_set_mac,
 	.fwd_config = mt7621_fwd_config,
 	.tx_dma = mt7621_tx_dma,
+	.rxcsum_config = mt7620_rxcsum_config,
 	.switch_init = mt7620_gsw_probe,
 	.switch_config = mt7621_gsw_config,
 	.reg_table = mt7621_reg_table,
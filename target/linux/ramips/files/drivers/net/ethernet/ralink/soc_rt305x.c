@@ -142,6 +142,7 @@ static struct fe_soc_data rt5350_data = {
 	.set_mac = rt5350_set_mac,
 	.fwd_config = rt5350_fwd_config,
 	.tx_dma = rt5350_tx_dma,
+	.rxcsum_config = rt5350_rxcsum_config,
 	.pdma_glo_cfg = FE_PDMA_SIZE_8DWORDS,
 	.checksum_bit = RX_DMA_L4VALID,
 	.rx_int = RT5350_RX_DONE_INT,
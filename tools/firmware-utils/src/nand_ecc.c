@@ -28,6 +28,7 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 
 #define DEF_NAND_PAGE_SIZE   2048
 #define DEF_NAND_OOB_SIZE     64
@@ -59,33 +60,66 @@ static const uint8_t nand_ecc_precalc_table[] = {
 	0x00, 0x55, 0x56, 0x03, 0x59, 0x0c, 0x0f, 0x5a, 0x5a, 0x0f, 0x0c, 0x59, 0x03, 0x56, 0x55, 0x00
 };
 
+static inline uint8_t nand_ecc_parity(uint64_t v)
+{
+	v ^= v >> 32;
+	v ^= v >> 16;
+	v ^= v >> 8;
+	return nand_ecc_precalc_table[v & 0xff] >> 6;
+}
+
 /**
  * nand_calculate_ecc - [NAND Interface] Calculate 3-byte ECC for 256-byte block
  * @dat:	raw data
  * @ecc_code:	buffer for ECC
+ *
+ * The block is processed as 32 64-bit words. Bits 3-7 of the line parity
+ * (the word index) are the parities of the XOR of all words whose index has
+ * the corresponding bit set, bits 0-2 (the byte position within the word)
+ * and the column parity follow from the byte lanes of the XOR of all words.
  */
 int nand_calculate_ecc(const uint8_t *dat,
 		       uint8_t *ecc_code)
 {
-	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
+	uint64_t w[4], sum, rp[5];
+	uint8_t lane[8], col;
+	uint8_t reg1, reg2, reg3, tmp1, tmp2;
 	int i;
 
 	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for(i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
-		}
+	sum = rp[0] = rp[1] = rp[2] = rp[3] = rp[4] = 0;
+
+	/* Build up the word parities, four words per round */
+	for (i = 0; i < 8; i++, dat += 32) {
+		memcpy(w, dat, sizeof(w));
+		rp[0] ^= w[1] ^ w[3];
+		rp[1] ^= w[2] ^ w[3];
+		w[0] ^= w[1] ^ w[2] ^ w[3];
+		sum ^= w[0];
+		if (i & 0x01)
+			rp[2] ^= w[0];
+		if (i & 0x02)
+			rp[3] ^= w[0];
+		if (i & 0x04)
+			rp[4] ^= w[0];
 	}
 
+	memcpy(lane, &sum, sizeof(lane));
+	col = lane[0] ^ lane[1] ^ lane[2] ^ lane[3] ^
+	      lane[4] ^ lane[5] ^ lane[6] ^ lane[7];
+
+	/* Get CP0 - CP5 and the all bit XOR from the table */
+	reg1 = nand_ecc_precalc_table[col];
+
+	reg3  = nand_ecc_parity(lane[1] ^ lane[3] ^ lane[5] ^ lane[7]) << 0;
+	reg3 |= nand_ecc_parity(lane[2] ^ lane[3] ^ lane[6] ^ lane[7]) << 1;
+	reg3 |= nand_ecc_parity(lane[4] ^ lane[5] ^ lane[6] ^ lane[7]) << 2;
+	for (i = 0; i < 5; i++)
+		reg3 |= nand_ecc_parity(rp[i]) << (i + 3);
+
+	reg2 = (reg1 & 0x40) ? ~reg3 : reg3;
+	reg1 &= 0x3f;
+
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
 	tmp1 |= (reg2 & 0x80) >> 1; /* B7 -> B6 */
@@ -29,15 +29,37 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <endian.h>
+#include <byteswap.h>
 
 #if __BYTE_ORDER == __BIG_ENDIAN
 #define cpu_to_le16(x) bswap_16(x)
+#define cpu_to_le32(x) bswap_32(x)
+#define cpu_to_le64(x) bswap_64(x)
 #elif __BYTE_ORDER == __LITTLE_ENDIAN
 #define cpu_to_le16(x) (x)
+#define cpu_to_le32(x) (x)
+#define cpu_to_le64(x) (x)
 #else
 #error unknown endianness!
 #endif
 
+#define DISK_SECTOR_SIZE	512
+#define MBR_ENTRY_MAX		4
+#define MBR_PART_MAX		0xffffffffULL
+
+#define GPT_SIGNATURE		"EFI PART"
+#define GPT_REVISION		0x00010000
+#define GPT_HEADER_SIZE		92
+#define GPT_HEADER_SECTOR	1
+#define GPT_FIRST_ENTRY_SECTOR	2
+#define GPT_ENTRY_SIZE		128
+#define GPT_ENTRY_MAX		128
+#define GPT_ENTRY_SECTORS	(GPT_ENTRY_SIZE * GPT_ENTRY_MAX / DISK_SECTOR_SIZE)
+#define GPT_DEFAULT_ALIGN	(1024 * 2)	/* 1 MiB in sectors */
+#define GPT_ATTR_LEGACY_BOOT	(1ULL << 2)
+#define MBR_TYPE_GPT_PROTECT	0xee
+
 /* Partition table entry */
 struct pte { 
 	unsigned char active;
@@ -48,8 +70,64 @@ struct pte {
 	unsigned int length;
 };
 
+/* GPT GUID, the first three fields are stored little endian */
+typedef struct {
+	uint32_t time_low;
+	uint16_t time_mid;
+	uint16_t time_hi;
+	uint8_t node[8];
+} __attribute__((packed)) guid_t;
+
+#define GUID_INIT(a, b, c, d0, d1, d2, d3, d4, d5, d6, d7) \
+	((guid_t) { cpu_to_le32(a), cpu_to_le16(b), cpu_to_le16(c), \
+		    { d0, d1, d2, d3, d4, d5, d6, d7 } })
+
+#define GUID_PARTITION_LINUX_FS \
+	GUID_INIT(0x0fc63daf, 0x8483, 0x4772, \
+		  0x8e, 0x79, 0x3d, 0x69, 0xd8, 0x47, 0x7d, 0xe4)
+#define GUID_PARTITION_LINUX_SWAP \
+	GUID_INIT(0x0657fd6d, 0xa4ab, 0x43c4, \
+		  0x84, 0xe5, 0x09, 0x33, 0xc8, 0x4b, 0x4f, 0x4f)
+#define GUID_PARTITION_BASIC_DATA \
+	GUID_INIT(0xebd0a0a2, 0xb9e5, 0x4433, \
+		  0x87, 0xc0, 0x68, 0xb6, 0xb7, 0x26, 0x99, 0xc7)
+#define GUID_PARTITION_SYSTEM \
+	GUID_INIT(0xc12a7328, 0xf81f, 0x11d2, \
+		  0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b)
+#define GUID_PARTITION_BIOS_BOOT \
+	GUID_INIT(0x21686148, 0x6449, 0x6e6f, \
+		  0x74, 0x4e, 0x65, 0x65, 0x64, 0x45, 0x46, 0x49)
+
+/* GPT header */
+struct gpth {
+	uint8_t signature[8];
+	uint32_t revision;
+	uint32_t size;
+	uint32_t crc32;
+	uint32_t reserved;
+	uint64_t self;
+	uint64_t alternate;
+	uint64_t first_usable;
+	uint64_t last_usable;
+	guid_t disk_guid;
+	uint64_t first_entry;
+	uint32_t entry_num;
+	uint32_t entry_size;
+	uint32_t entry_crc32;
+} __attribute__((packed));
+
+/* GPT partition table entry */
+struct gpte {
+	guid_t type;
+	guid_t guid;
+	uint64_t start;
+	uint64_t end;
+	uint64_t attr;
+	uint16_t name[36];
+} __attribute__((packed));
+
 struct partinfo {
-	unsigned long size;
+	uint64_t size;
 	int type;
 };
 
@@ -58,7 +136,9 @@ int active = 1;
 int heads = -1;
 int sectors = -1;
 int kb_align = 0;
-struct partinfo parts[4];
+int use_gpt = 0;
+int hybrid = 0;
+struct partinfo parts[GPT_ENTRY_MAX];
 char *filename = NULL;
 
 
@@ -69,12 +149,12 @@ char *filename = NULL;
  *
  * returns the size in KByte
  */
-static long to_kbytes(const char *string) {
+static uint64_t to_kbytes(const char *string) {
 	int exp = 0;
-	long result;
+	uint64_t result;
 	char *end;
 
-	result = strtoul(string, &end, 0);
+	result = strtoull(string, &end, 0);
 	switch (tolower(*end)) {
 			case 'k' :
 			case '\0' : exp = 0; break;
@@ -96,13 +176,21 @@ static long to_kbytes(const char *string) {
 }
 
 /* convert the sector number into a CHS value for the partition table */
-static void to_chs(long sect, unsigned char chs[3]) {
+static void to_chs(uint64_t sect, unsigned char chs[3]) {
 	int c,h,s;
 	
 	s = (sect % sectors) + 1;
 	sect = sect / sectors;
 	h = sect % heads;
 	sect = sect / heads;
+
+	/* beyond the CHS limit, use the maximum value as usual */
+	if (sect > 1023) {
+		chs[0] = 0xfe;
+		chs[1] = 0xff;
+		chs[2] = 0xff;
+		return;
+	}
 	c = sect;
 
 	chs[0] = h;
@@ -113,23 +201,35 @@ static void to_chs(long sect, unsigned char chs[3]) {
 }
 
 /* round the sector number up to the next cylinder */
-static inline unsigned long round_to_cyl(long sect) {
+static inline uint64_t round_to_cyl(uint64_t sect) {
 	int cyl_size = heads * sectors;
 
 	return sect + cyl_size - (sect % cyl_size); 
 }
 
 /* round the sector number up to the kb_align boundary */
-static inline unsigned long round_to_kb(long sect) {
+static inline uint64_t round_to_kb(uint64_t sect) {
         return ((sect - 1) / kb_align + 1) * kb_align;
 }
 
+/* report the partition offset and size, the image scripts parse these */
+static void print_partition(int i, uint64_t start, uint64_t len)
+{
+	if (verbose)
+		fprintf(stderr, "Partition %d: start=%llu, end=%llu, size=%llu\n", i,
+			(unsigned long long) start * DISK_SECTOR_SIZE,
+			(unsigned long long) (start + len) * DISK_SECTOR_SIZE,
+			(unsigned long long) len * DISK_SECTOR_SIZE);
+	printf("%llu\n", (unsigned long long) start * DISK_SECTOR_SIZE);
+	printf("%llu\n", (unsigned long long) len * DISK_SECTOR_SIZE);
+}
+
 /* check the partition sizes and write the partition table */
 static int gen_ptable(uint32_t signature, int nr)
 {
 	struct pte pte[4];
-	unsigned long sect = 0; 
-	int i, fd, ret = -1, start, len;
+	uint64_t sect = 0, start, len;
+	int i, fd, ret = -1;
 
 	memset(pte, 0, sizeof(struct pte) * 4);
 	for (i = 0; i < nr; i++) {
@@ -142,17 +242,19 @@ static int gen_ptable(uint32_t signature, int nr)
 		start = sect + sectors;
 		if (kb_align != 0)
 			start = round_to_kb(start);
-		pte[i].start = cpu_to_le16(start);
 		sect = start + parts[i].size * 2;
 		if (kb_align == 0)
 			sect = round_to_cyl(sect);
-		pte[i].length = cpu_to_le16(len = sect - start);
+		len = sect - start;
+		if (sect > MBR_PART_MAX) {
+			fprintf(stderr, "Partition %d exceeds the MBR limit, use GPT!\n", i);
+			return -1;
+		}
+		pte[i].start = cpu_to_le32(start);
+		pte[i].length = cpu_to_le32(len);
 		to_chs(start, pte[i].chs_start);
 		to_chs(start + len - 1, pte[i].chs_end);
-		if (verbose)
-			fprintf(stderr, "Partition %d: start=%ld, end=%ld, size=%ld\n", i, (long) start * 512, ((long) start + (long) len) * 512, (long) len * 512);
-		printf("%ld\n", ((long) start * 512));
-		printf("%ld\n", ((long) len * 512));
+		print_partition(i, start, len);
 	}
 
 	if ((fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
@@ -183,9 +285,178 @@ fail:
 	return ret;
 }
 
+/* CRC32 as used by GPT (IEEE 802.3, reflected) */
+static uint32_t gpt_crc32(const void *data, size_t len)
+{
+	static uint32_t table[256];
+	const uint8_t *p = data;
+	uint32_t crc = 0xffffffff;
+	int i, j;
+
+	if (!table[1]) {
+		for (i = 0; i < 256; i++) {
+			uint32_t c = i;
+
+			for (j = 0; j < 8; j++)
+				c = (c & 1) ? (c >> 1) ^ 0xedb88320 : c >> 1;
+			table[i] = c;
+		}
+	}
+
+	while (len--)
+		crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+/* map the MBR partition type given with -t to a GPT partition type */
+static guid_t type_to_guid(int type)
+{
+	switch (type & 0xff) {
+	case 0x82:
+		return GUID_PARTITION_LINUX_SWAP;
+	case 0x0b:
+	case 0x0c:
+	case 0x07:
+		return GUID_PARTITION_BASIC_DATA;
+	case 0xef:
+		return GUID_PARTITION_SYSTEM;
+	case 0xda:
+		return GUID_PARTITION_BIOS_BOOT;
+	default:
+		return GUID_PARTITION_LINUX_FS;
+	}
+}
+
+static void init_mbr_pte(struct pte *pte, int type, uint64_t start, uint64_t len)
+{
+	if (start + len > MBR_PART_MAX)
+		len = MBR_PART_MAX;
+
+	pte->type = type;
+	pte->start = cpu_to_le32(start);
+	pte->length = cpu_to_le32(len);
+	to_chs(start, pte->chs_start);
+	to_chs(start + len - 1, pte->chs_end);
+}
+
+static int write_sectors(int fd, uint64_t sect, const void *data, size_t len)
+{
+	if (pwrite(fd, data, len, sect * DISK_SECTOR_SIZE) != (ssize_t) len) {
+		fprintf(stderr, "write failed.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * check the partition sizes and write a GPT with a protective (or hybrid)
+ * MBR; the backup table is written at the end of the disk, which leaves
+ * the unwritten parts of the output file as holes
+ */
+static int gen_gptable(uint32_t signature, guid_t guid, int nr)
+{
+	struct pte pte[MBR_ENTRY_MAX];
+	struct gpte gpte[GPT_ENTRY_MAX];
+	uint8_t sector[DISK_SECTOR_SIZE];
+	struct gpth *gpth = (struct gpth *) sector;
+	uint64_t sect = GPT_FIRST_ENTRY_SECTOR + GPT_ENTRY_SECTORS;
+	uint64_t first_usable = sect, start, len, last_usable, backup;
+	int i, mbr = 0, fd, ret = -1;
+
+	memset(pte, 0, sizeof(pte));
+	memset(gpte, 0, sizeof(gpte));
+	for (i = 0; i < nr; i++) {
+		if (!parts[i].size) {
+			fprintf(stderr, "Invalid size in partition %d!\n", i);
+			return -1;
+		}
+		start = round_to_kb(sect);
+		len = parts[i].size * 2;
+		sect = start + len;
+
+		gpte[i].type = type_to_guid(parts[i].type);
+		gpte[i].guid = guid;
+		gpte[i].guid.node[7] += i + 1;
+		gpte[i].start = cpu_to_le64(start);
+		gpte[i].end = cpu_to_le64(sect - 1);
+		if ((i + 1) == active)
+			gpte[i].attr = cpu_to_le64(GPT_ATTR_LEGACY_BOOT);
+
+		/* mirror the first partitions into the MBR */
+		if (hybrid && mbr < MBR_ENTRY_MAX - 1 && sect <= MBR_PART_MAX) {
+			init_mbr_pte(&pte[mbr], parts[i].type, start, len);
+			pte[mbr++].active = ((i + 1) == active) ? 0x80 : 0;
+		}
+
+		print_partition(i, start, len);
+	}
+
+	last_usable = round_to_kb(sect) - 1;
+	backup = last_usable + 1 + GPT_ENTRY_SECTORS;
+
+	if (hybrid)
+		init_mbr_pte(&pte[mbr], MBR_TYPE_GPT_PROTECT, GPT_HEADER_SECTOR,
+			     first_usable - GPT_HEADER_SECTOR);
+	else
+		init_mbr_pte(&pte[mbr], MBR_TYPE_GPT_PROTECT, GPT_HEADER_SECTOR,
+			     backup);
+
+	if ((fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "Can't open output file '%s'\n",filename);
+		return -1;
+	}
+
+	memset(sector, 0, sizeof(sector));
+	memcpy(sector + 440, &signature, sizeof(signature));
+	memcpy(sector + 446, pte, sizeof(pte));
+	sector[510] = 0x55;
+	sector[511] = 0xaa;
+	if (write_sectors(fd, 0, sector, sizeof(sector)))
+		goto fail;
+
+	memset(sector, 0, sizeof(sector));
+	memcpy(gpth->signature, GPT_SIGNATURE, sizeof(gpth->signature));
+	gpth->revision = cpu_to_le32(GPT_REVISION);
+	gpth->size = cpu_to_le32(GPT_HEADER_SIZE);
+	gpth->self = cpu_to_le64(GPT_HEADER_SECTOR);
+	gpth->alternate = cpu_to_le64(backup);
+	gpth->first_usable = cpu_to_le64(first_usable);
+	gpth->last_usable = cpu_to_le64(last_usable);
+	gpth->disk_guid = guid;
+	gpth->first_entry = cpu_to_le64(GPT_FIRST_ENTRY_SECTOR);
+	gpth->entry_num = cpu_to_le32(GPT_ENTRY_MAX);
+	gpth->entry_size = cpu_to_le32(GPT_ENTRY_SIZE);
+	gpth->entry_crc32 = cpu_to_le32(gpt_crc32(gpte, sizeof(gpte)));
+	gpth->crc32 = cpu_to_le32(gpt_crc32(gpth, GPT_HEADER_SIZE));
+	if (write_sectors(fd, GPT_HEADER_SECTOR, sector, sizeof(sector)) ||
+	    write_sectors(fd, GPT_FIRST_ENTRY_SECTOR, gpte, sizeof(gpte)))
+		goto fail;
+
+	/* the backup header swaps the locations and points at the backup entries */
+	gpth->crc32 = 0;
+	gpth->self = cpu_to_le64(backup);
+	gpth->alternate = cpu_to_le64(GPT_HEADER_SECTOR);
+	gpth->first_entry = cpu_to_le64(last_usable + 1);
+	gpth->crc32 = cpu_to_le32(gpt_crc32(gpth, GPT_HEADER_SIZE));
+	if (write_sectors(fd, last_usable + 1, gpte, sizeof(gpte)) ||
+	    write_sectors(fd, backup, sector, sizeof(sector)))
+		goto fail;
+
+	if (verbose)
+		fprintf(stderr, "Disk size: %llu\n",
+			(unsigned long long) (backup + 1) * DISK_SECTOR_SIZE);
+
+	ret = 0;
+fail:
+	close(fd);
+	return ret;
+}
+
 static void usage(char *prog)
 {
-	fprintf(stderr,	"Usage: %s [-v] -h <heads> -s <sectors> -o <outputfile> [-a 0..4] [-l <align kB>] [[-t <type>] -p <size>...] \n", prog);
+	fprintf(stderr,	"Usage: %s [-v] [-g [-H]] -h <heads> -s <sectors> -o <outputfile> [-a 0..4] [-l <align kB>] [[-t <type>] -p <size>...] \n", prog);
 	exit(1);
 }
 
@@ -195,8 +466,9 @@ int main (int argc, char **argv)
 	int ch;
 	int part = 0;
 	uint32_t signature = 0x5452574F; /* 'OWRT' */
+	guid_t guid;
 
-	while ((ch = getopt(argc, argv, "h:s:p:a:t:o:vl:S:")) != -1) {
+	while ((ch = getopt(argc, argv, "h:s:p:a:t:o:vl:S:gH")) != -1) {
 		switch (ch) {
 		case 'o':
 			filename = optarg;
@@ -211,7 +483,7 @@ int main (int argc, char **argv)
 			sectors = (int) strtoul(optarg, NULL, 0);
 			break;
 		case 'p':
-			if (part > 3) {
+			if (part > GPT_ENTRY_MAX - 1) {
 				fprintf(stderr, "Too many partitions\n");
 				exit(1);
 			}
@@ -232,6 +504,12 @@ int main (int argc, char **argv)
 		case 'S':
 			signature = strtoul(optarg, NULL, 0);
 			break;
+		case 'g':
+			use_gpt = 1;
+			break;
+		case 'H':
+			hybrid = 1;
+			break;
 		case '?':
 		default:
 			usage(argv[0]);
@@ -241,5 +519,21 @@ int main (int argc, char **argv)
 	if (argc || (heads <= 0) || (sectors <= 0) || !filename) 
 		usage(argv[0]);
 
+	if (!use_gpt && part > MBR_ENTRY_MAX) {
+		fprintf(stderr, "Too many partitions\n");
+		exit(1);
+	}
+
+	if (use_gpt) {
+		if (kb_align == 0)
+			kb_align = GPT_DEFAULT_ALIGN;
+
+		/* derive the GUIDs from the signature to keep images reproducible */
+		guid = GUID_INIT(signature, 0x2211, 0x4433,
+				 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x00);
+
+		return gen_gptable(signature, guid, part);
+	}
+
 	return gen_ptable(signature, part);
 }
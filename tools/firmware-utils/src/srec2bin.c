@@ -1,6 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 //Rev 0.1 Original
 // 8 Jan 2001  MJH  Added code to write data to Binary file
@@ -63,12 +68,21 @@ int BigEndian;
 
 int inputline;
 
-// char buf[16*1024];
+// The input is mapped and split into lines in place, the binary output is
+// collected in memory and written out with a single fwrite() at the end.
 
-char buffer[2048];
 char *cur_ptr;
+char *cur_end;
 int cur_line=0;
-int cur_len=0;
+
+bit8u *OutBuf;
+size_t OutLen;
+size_t OutSize;
+int OutError;
+
+// Hex digit values, 0xFF for anything else
+
+bit8u HexTab[256];
 
 int s1s2s3_total=0;
 
@@ -83,7 +97,7 @@ void dumpfTell(char *s, bit32u Value)
     Length = (int) RecLength;
     if (debug)
           printf("[%s  ] ftell()[0x%08lX] Length[0x%4X] Length[%4d] Value[0x%08x]\n",
-                s, ftell(fOut), Length, Length, Value);
+                s, (long) OutLen, Length, Length, Value);
 }
 
 void DispHex(bit32u Hex)
@@ -107,18 +121,45 @@ void WaitDisplay(void)
 }
 
 
-void binOut32 ( bit32u Data )
+// Make room for Length more bytes in the output buffer
+
+bit8u *binReserve ( size_t Length )
 {
-// On UNIX machine all 32bit writes need ENDIAN switched
-//    Data = EndianSwitch(Data);
-//    fwrite( &Data, sizeof(bit32u), 1, fOut);
+   bit8u *buf;
+   size_t size;
+
+   if (OutLen + Length > OutSize)
+   {
+     size = OutSize ? OutSize : 64 * 1024;
+     while (size < OutLen + Length)
+       size *= 2;
+
+     buf = realloc(OutBuf, size);
+     if (buf == NULL)
+     {
+       printf("\nError: Out of memory for %lu bytes of output.", (unsigned long) size);
+       exit(1);
+     }
+     OutBuf = buf;
+     OutSize = size;
+   }
+   return(OutBuf + OutLen);
+}
 
-   char sdat[4];
+void binPut32 ( bit8u *sdat, bit32u Data )
+{
    int i;
 
    for(i=0;i<4;i++)
-    sdat[i]=(char)(Data>>(i*8));
-   fwrite( sdat, 1, 4, fOut);
+    sdat[i]=(bit8u)(Data>>(i*8));
+}
+
+void binOut32 ( bit32u Data )
+{
+// Always written little endian, independent of the host
+
+   binPut32( binReserve(4), Data );
+   OutLen += 4;
    dumpfTell("Out32" , Data);
 }
 
@@ -127,14 +168,23 @@ void binOut32 ( bit32u Data )
 
 void binOut8 ( bit8u Data )
 {
-    int n;
     dumpfTell("B4Data" , (bit32u) (Data & 0xFF) );
-    n = fwrite( &Data, sizeof(bit8u), 1, fOut);
-    if (n != 1)
-        printf("Error in writing %X for Address 0x%8X\n", Data, AddressCurrent);
+    *binReserve(1) = Data;
+    OutLen += 1;
     RecLength += 1;
 }
 
+void binOutData ( bit8u *Data, int Length )
+{
+    int i;
+
+    memcpy( binReserve(Length), Data, Length );
+    OutLen += Length;
+    RecLength += Length;
+    for(i=0;i<Length;i++)
+      CheckSum += Data[i];
+}
+
 //  Currently ONLY used for outputting Program Start
 
 void binRecStart(bit32u Address)
@@ -166,27 +216,17 @@ void binRecEnd(void)
     RecStart = FALSE;
 
 
-    RecEnd = ftell(fOut);         // Save Current position
+    RecEnd = OutLen;              // Current position
 
     if (debug)
           printf("[RecEnd  ] CheckSum[0x%08X] Length[%4d] Length[0x%X] RecEnd[0x%08lX]\n",
                 CheckSum, RecLength, RecLength, RecEnd);
 
-    fseek( fOut, -((long) RecLength), SEEK_CUR);  // move back Start Of Data
-
-    dumpfTell("Data   ", -1);
-
-    fseek( fOut, -4, SEEK_CUR);  // move back Start Of Address
+    // patch the Length in front of Address and Data
 
-    dumpfTell("Address   ", -1);
-
-    fseek( fOut, -4, SEEK_CUR);  // move back Start Of Length
-
-    dumpfTell("Length   ", -1);
-
-    binOut32( RecLength );
+    binPut32( OutBuf + RecEnd - RecLength - 8, RecLength );
 
-    fseek( fOut, RecEnd, SEEK_SET);  // move to end of Record
+    dumpfTell("Length   ", RecLength);
 
     CheckSum += RecLength;
 
@@ -223,62 +263,51 @@ void binRecOutByte(bit32u Address, bit8u Data)
     binOut8( Data );
 }
 
+//  Output the data of one record, only its first byte can start a new
+//  record, the rest is contiguous
+
+void binRecOutData(bit32u Address, bit8u *Data, int Length)
+{
+    if (Length == 0)
+      return;
+
+    binRecOutByte(Address, Data[0]);
+    binOutData(Data + 1, Length - 1);
+    AddressCurrent = Address + Length - 1;
+}
+
 //=============================================================================
 //       SUPPORT FUNCTIONS
 //=============================================================================
-int readline(FILE *fil,char *buf,int len)
+// Copy the next line of the mapped input into buf, dropping '\r' and
+// truncating it to len-1 characters. Returns -1 at the end of the input.
+
+int readline(char *buf,int len)
 {
+    char *end;
     int rlen;
-    
-    rlen=0;
-    if (len==0)  return(0);
-    while(1)
+
+    if (cur_ptr >= cur_end)  return(-1);
+
+    end = memchr(cur_ptr, '\n', cur_end - cur_ptr);
+    if (end == NULL)
+      end = cur_end;
+
+    rlen = end - cur_ptr;
+    while (cur_ptr < end)
     {
-      if (cur_len==0)
+      if ((len>1)&&(*cur_ptr!='\r'))
       {
-        cur_len=fread(buffer, 1, sizeof(buffer), fil);
-        if (cur_len==0)
-        {
-          if (rlen)
-          {
-            *buf=0;
-            return(rlen);
-          }
-          return(-1);
-        }
-        cur_ptr=buffer;
-      }
-      if (cur_len)
-      {
-        if (*cur_ptr=='\n')
-        {
-          *buf=0;
-          cur_ptr++;
-          cur_len--;
-          return(rlen);
-        }
-         else
-         {
-           if ((len>1)&&(*cur_ptr!='\r'))
-           {
-             *buf++=*cur_ptr++;
-             len--;
-           }
-           else
-             cur_ptr++;
-
-           rlen++;
-           cur_len--;
-         }
-      }
-      else
-      {
-        *buf=0;
-        cur_ptr++;
-        cur_len--;
-        return(rlen);
+        *buf++=*cur_ptr;
+        len--;
       }
+      cur_ptr++;
     }
+    if (len)
+      *buf=0;
+    if (cur_ptr < cur_end)
+      cur_ptr++;              // skip the newline
+    return(rlen);
 }
 
 
@@ -289,35 +318,63 @@ int SRLerrorout(char *c1,char *c2)
 }
 
 
-int checksum(char *cp,int count)
+void HexTabInit(void)
 {
-  char *scp;
-  int cksum;
-  int dum;
+  int i;
 
-  scp=cp;
-  while(*scp)
+  memset(HexTab, 0xFF, sizeof(HexTab));
+  for(i=0;i<10;i++)
+    HexTab['0'+i]=i;
+  for(i=0;i<6;i++)
   {
-    if (!isxdigit(*scp++))
-      return(SRLerrorout("Invalid hex digits",cp));
+    HexTab['A'+i]=10+i;
+    HexTab['a'+i]=10+i;
   }
-  scp=cp;
+}
 
+// Decode the count bytes of cp into dat and validate the checksum,
+// cp must hold exactly count*2 characters
+
+int checksum(char *cp,int count,bit8u *dat)
+{
+  bit8u *scp;
+  int cksum;
+  int i;
+  bit8u hi,lo,bad;
+
+  scp=(bit8u *)cp;
   cksum=count;
+  bad=0;
 
-  while(count)
+  for(i=0;i<count;i++)
   {
-    cksum += gh(scp,2);
-    if (count == 2)
-        dum = ~cksum;
-    scp += 2;
-    count--;
+    hi=HexTab[scp[0]];
+    lo=HexTab[scp[1]];
+    bad|=hi|lo;
+    dat[i]=(hi<<4)|lo;
+    cksum+=dat[i];
+    scp+=2;
   }
+  if (bad & 0xF0)
+    return(SRLerrorout("Invalid hex digits",cp));
+
   cksum&=0x0ff; 
   //  printf("\nCk:%02x",cksum);
   return(cksum==0x0ff);
 }
 
+// Hex digits are upper cased in place while they are parsed, so errors
+// about a parsed record show it that way
+
+int SRLrecerrorout(char *c1,char *c2)
+{
+  char *cp;
+
+  for(cp=c2+2;*cp;cp++)
+    if ((*cp>='a')&&(*cp<='z')) *cp &= 0x5f;
+  return(SRLerrorout(c1,c2));
+}
+
 bit32u gh(char *cp,int nibs)
 {
   int i;
@@ -349,8 +406,9 @@ bit32u gh(char *cp,int nibs)
 int srecLine(char *pSrecLine)
 {
     char *scp,ch;
-    int  itmp,count,dat;
+    int  itmp,count;
     bit32u adr;
+    bit8u dat[256];
     static bit32u RecordCounter=0;
 
     cur_line++;
@@ -375,50 +433,44 @@ int srecLine(char *pSrecLine)
   
     if ((count*2) != strlen(pSrecLine)) return(SRLerrorout("Count field larger than record",scp));
   
-    if (!checksum(pSrecLine, count)) return(SRLerrorout("Bad Checksum",scp));
+    if (!checksum(pSrecLine, count, dat)) return(SRLrecerrorout("Bad Checksum",scp));
   
     switch(ch)
     {
-        case '0': if (count<3) return(SRLerrorout("Invalid Srecord count field",scp));
-                  itmp=gh(pSrecLine,4); pSrecLine+=4; count-=2;
-                  if (itmp) return(SRLerrorout("Srecord 1 address not zero",scp));
+        case '0': if (count<3) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  itmp=(dat[0]<<8)|dat[1];
+                  if (itmp) return(SRLrecerrorout("Srecord 1 address not zero",scp));
         break;
-        case '1': if (count<3) return(SRLerrorout("Invalid Srecord count field",scp));
-                  return(SRLerrorout("Srecord Not valid for MIPS",scp));
+        case '1': if (count<3) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  return(SRLrecerrorout("Srecord Not valid for MIPS",scp));
         break;
-        case '2': if (count<4) return(SRLerrorout("Invalid Srecord count field",scp));
-                  return(SRLerrorout("Srecord Not valid for MIPS",scp));
+        case '2': if (count<4) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  return(SRLrecerrorout("Srecord Not valid for MIPS",scp));
         break;
-        case '3': if (count<5) return(SRLerrorout("Invalid Srecord count field",scp));
-                  adr=gh(pSrecLine,8); pSrecLine+=8; count-=4;
-                  count--;
-                  while(count)
-                  {
-                    dat=gh(pSrecLine,2); pSrecLine+=2; count--;
-                    binRecOutByte(adr, (char) (dat & 0xFF));
-                    adr++;
-                  }
+        case '3': if (count<5) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  adr=(dat[0]<<24)|(dat[1]<<16)|(dat[2]<<8)|dat[3];
+                  binRecOutData(adr, dat + 4, count - 5);
                   s1s2s3_total++;
         break;
-        case '4': return(SRLerrorout("Invalid Srecord type",scp));
+        case '4': return(SRLrecerrorout("Invalid Srecord type",scp));
         break;
-        case '5': if (count<3) return(SRLerrorout("Invalid Srecord count field",scp));
-                  itmp=gh(pSrecLine,4); pSrecLine+=4; count-=2;
-                  if (itmp|=s1s2s3_total) return(SRLerrorout("Incorrect number of S3 Record processed",scp));
+        case '5': if (count<3) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  itmp=(dat[0]<<8)|dat[1];
+                  if (itmp|=s1s2s3_total) return(SRLrecerrorout("Incorrect number of S3 Record processed",scp));
         break;
-        case '6': return(SRLerrorout("Invalid Srecord type",scp));
+        case '6': return(SRLrecerrorout("Invalid Srecord type",scp));
         break;
         case '7': // PROGRAM START
-                  if (count<5) return(SRLerrorout("Invalid Srecord count field",scp));
-                  adr=gh(pSrecLine,8); pSrecLine+=8; count-=4;
-                  if (count!=1) return(SRLerrorout("Invalid Srecord count field",scp));
+                  if (count<5) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  adr=(dat[0]<<24)|(dat[1]<<16)|(dat[2]<<8)|dat[3];
+                  if (count!=5) return(SRLrecerrorout("Invalid Srecord count field",scp));
                   binRecOutProgramStart(adr);
         break;
-        case '8': if (count<4) return(SRLerrorout("Invalid Srecord count field",scp));
-                  return(SRLerrorout("Srecord Not valid for MIPS",scp));
+        case '8': if (count<4) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  return(SRLrecerrorout("Srecord Not valid for MIPS",scp));
         break;
-        case '9': if (count<3) return(SRLerrorout("Invalid Srecord count field",scp));
-                  return(SRLerrorout("Srecord Not valid for MIPS",scp));
+        case '9': if (count<3) return(SRLrecerrorout("Invalid Srecord count field",scp));
+                  return(SRLrecerrorout("Srecord Not valid for MIPS",scp));
         break;
         default:
         break;
@@ -434,7 +486,9 @@ int srecLine(char *pSrecLine)
 int srec2bin(int argc,char *argv[],int verbose)
 {
     int i,rlen,sts;
-    FILE *fp;
+    int fd;
+    struct stat st;
+    char *map;
     char ac;
     char buff[256];
     bit32u TAG_BIG     = 0xDEADBE42;
@@ -459,22 +513,43 @@ int srec2bin(int argc,char *argv[],int verbose)
     if (verbose)
        printf("\nEndian: %s, Tag is 0x%8X\n",(BigEndian)?"BIG":"LITTLE", Tag);
 
-    fp = fopen(argv[1],"rt");
+    fd = open(argv[1],O_RDONLY);
 
-    if (fp==NULL)
+    if ((fd<0) || fstat(fd,&st))
     {
       printf("\nError: Opening input file, %s.", argv[1]);
+      if(fd>=0) close(fd);
       return(0);
     }
+
+    map = NULL;
+    if (st.st_size)
+    {
+      map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED)
+      {
+        printf("\nError: Reading input file, %s.", argv[1]);
+        close(fd);
+        return(0);
+      }
+    }
+    close(fd);
+
+    cur_ptr = map;
+    cur_end = map + st.st_size;
   
     fOut = fopen( argv[2], "wb");
     
     if (fOut==NULL)
     {
       printf("\nError: Opening Output file, %s.", argv[2]);
-      if(fp) fclose(fp);
+      if(map) munmap(map, st.st_size);
       return(0);
     }
+
+    // two hex digits per output byte, plus the record overhead
+    HexTabInit();
+    binReserve(st.st_size / 2 + 4);
  
     RecStart = FALSE;
 
@@ -490,7 +565,7 @@ int srec2bin(int argc,char *argv[],int verbose)
     inputline=0;
     sts=TRUE;
 
-    rlen = readline(fp,buff,sizeof buff);
+    rlen = readline(buff,sizeof buff);
 
     while( (sts) && (rlen != -1))
     {
@@ -499,7 +574,7 @@ int srec2bin(int argc,char *argv[],int verbose)
             sts &= srecLine(buff);
             WaitDisplay();
         }
-       rlen = readline(fp,buff,sizeof buff);
+       rlen = readline(buff,sizeof buff);
     }
 
   
@@ -507,8 +582,12 @@ int srec2bin(int argc,char *argv[],int verbose)
   
     binRecEnd();
 
-    if(fp) fclose(fp);
+    if (OutLen && (fwrite(OutBuf, 1, OutLen, fOut) != OutLen))
+        printf("Error in writing %lu bytes to %s\n", (unsigned long) OutLen, argv[2]);
+
+    if(map) munmap(map, st.st_size);
     if(fOut) fclose(fOut);
+    free(OutBuf);
 
     return(1);
 }
@@ -34,6 +34,8 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -44,20 +46,43 @@
 
 #include <arpa/inet.h>
 
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "md5.h"
 
 
 #define ALIGN(x,a) ({ typeof(a) __a = (a); (((x) + __a - 1) & ~(__a - 1)); })
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
-/** An image partition table entry */
+
+/**
+   An image partition table entry
+
+   Only the first data_len bytes of the partition are backed by data, the
+   rest is 0xff padding (ending with a jffs2 EOF marker if jffs2_eof is set)
+   which is generated while writing the image.
+*/
 struct image_partition_entry {
 	const char *name;
 	size_t size;
 	uint8_t *data;
+	size_t data_len;
+	bool mapped;
+	bool jffs2_eof;
+};
+
+/** A firmware image as a list of fragments pointing into the image partitions */
+struct image_vec {
+	struct iovec *iov;
+	size_t cnt;
+	size_t alloc;
+	size_t len;
 };
 
 /** A flash partition table entry */
@@ -87,6 +112,9 @@ struct __attribute__((__packed__)) soft_version {
 
 static const uint8_t jffs2_eof_mark[4] = {0xde, 0xad, 0xc0, 0xde};
 
+/** A block of 0xff bytes used for all padding in the image */
+static uint8_t ff_pad[0x10000];
+
 
 /**
    Salt for the MD5 hash
@@ -153,7 +181,7 @@ static const unsigned char cpe510_support_list[] =
 
 /** Allocates a new image partition */
 struct image_partition_entry alloc_image_partition(const char *name, size_t len) {
-	struct image_partition_entry entry = {name, len, malloc(len)};
+	struct image_partition_entry entry = {name, len, malloc(len), len};
 	if (!entry.data)
 		error(1, errno, "malloc");
 
@@ -162,7 +190,10 @@ struct image_partition_entry alloc_image_partition(const char *name, size_t len)
 
 /** Frees an image partition */
 void free_image_partition(struct image_partition_entry entry) {
-	free(entry.data);
+	if (entry.mapped)
+		munmap(entry.data, entry.data_len);
+	else
+		free(entry.data);
 }
 
 /** Generates the partition-table partition */
@@ -239,42 +270,92 @@ struct image_partition_entry make_support_list(const unsigned char *support_list
 	return entry;
 }
 
-/** Creates a new image partition with an arbitrary name from a file */
+/** Creates a new image partition with an arbitrary name from a file; the file is mapped, not copied */
 struct image_partition_entry read_file(const char *part_name, const char *filename, bool add_jffs2_eof) {
+	struct image_partition_entry entry = {part_name};
 	struct stat statbuf;
 
-	if (stat(filename, &statbuf) < 0)
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		error(1, errno, "unable to open file `%s'", filename);
+
+	if (fstat(fd, &statbuf) < 0)
 		error(1, errno, "unable to stat file `%s'", filename);
 
-	size_t len = statbuf.st_size;
+	entry.data_len = statbuf.st_size;
+	entry.size = entry.data_len;
 
-	if (add_jffs2_eof)
-		len = ALIGN(len, 0x10000) + sizeof(jffs2_eof_mark);
+	if (add_jffs2_eof) {
+		entry.size = ALIGN(entry.size, 0x10000) + sizeof(jffs2_eof_mark);
+		entry.jffs2_eof = true;
+	}
 
-	struct image_partition_entry entry = alloc_image_partition(part_name, len);
+	if (entry.data_len) {
+		entry.data = mmap(NULL, entry.data_len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (entry.data == MAP_FAILED)
+			error(1, errno, "unable to map file `%s'", filename);
 
-	FILE *file = fopen(filename, "rb");
-	if (!file)
-		error(1, errno, "unable to open file `%s'", filename);
+		entry.mapped = true;
+	}
 
-	if (fread(entry.data, statbuf.st_size, 1, file) != 1)
-		error(1, errno, "unable to read file `%s'", filename);
+	close(fd);
 
-	if (add_jffs2_eof) {
-		uint8_t *eof = entry.data + statbuf.st_size, *end = entry.data+entry.size;
+	return entry;
+}
 
-		memset(eof, 0xff, end - eof - sizeof(jffs2_eof_mark));
-		memcpy(end - sizeof(jffs2_eof_mark), jffs2_eof_mark, sizeof(jffs2_eof_mark));
+
+/** Appends a fragment to an image */
+static void image_vec_add(struct image_vec *image, const void *data, size_t len) {
+	if (!len)
+		return;
+
+	if (image->cnt == image->alloc) {
+		image->alloc = image->alloc ? 2*image->alloc : 16;
+		image->iov = realloc(image->iov, image->alloc * sizeof(struct iovec));
+		if (!image->iov)
+			error(1, errno, "realloc");
 	}
 
-	fclose(file);
+	image->iov[image->cnt].iov_base = (void *)data;
+	image->iov[image->cnt].iov_len = len;
+	image->cnt++;
+	image->len += len;
+}
 
-	return entry;
+/** Appends len bytes of 0xff padding to an image */
+static void image_vec_pad(struct image_vec *image, size_t len) {
+	if (ff_pad[0] != 0xff)
+		memset(ff_pad, 0xff, sizeof(ff_pad));
+
+	while (len) {
+		size_t n = len < sizeof(ff_pad) ? len : sizeof(ff_pad);
+
+		image_vec_add(image, ff_pad, n);
+		len -= n;
+	}
+}
+
+/** Pads an image with 0xff up to the given offset */
+static void image_vec_pad_to(struct image_vec *image, size_t offset) {
+	assert(image->len <= offset);
+	image_vec_pad(image, offset - image->len);
+}
+
+/** Appends an image partition, including its padding, to an image */
+static void image_vec_add_partition(struct image_vec *image, const struct image_partition_entry *part) {
+	image_vec_add(image, part->data, part->data_len);
+
+	if (part->jffs2_eof) {
+		image_vec_pad(image, part->size - part->data_len - sizeof(jffs2_eof_mark));
+		image_vec_add(image, jffs2_eof_mark, sizeof(jffs2_eof_mark));
+	} else {
+		image_vec_pad(image, part->size - part->data_len);
+	}
 }
 
 
 /**
-   Copies a list of image partitions into an image buffer and generates the image partition table while doing so
+   Appends a list of image partitions to an image and generates the image partition table into buffer while doing so
 
    Example image partition table:
 
@@ -300,13 +381,13 @@ struct image_partition_entry read_file(const char *part_name, const char *filena
 
    I think partition-table must be the first partition in the firmware image.
 */
-void put_partitions(uint8_t *buffer, const struct image_partition_entry *parts) {
+void put_partitions(uint8_t *buffer, const struct image_partition_entry *parts, struct image_vec *image) {
 	size_t i;
 	char *image_pt = (char *)buffer, *end = image_pt + 0x800;
 
 	size_t base = 0x800;
 	for (i = 0; parts[i].name; i++) {
-		memcpy(buffer + base, parts[i].data, parts[i].size);
+		image_vec_add_partition(image, &parts[i]);
 
 		size_t len = end-image_pt;
 		size_t w = snprintf(image_pt, len, "fwup-ptn %s base 0x%05x size 0x%05x\t\r\n", parts[i].name, (unsigned)base, (unsigned)parts[i].size);
@@ -324,13 +405,27 @@ void put_partitions(uint8_t *buffer, const struct image_partition_entry *parts)
 	memset(image_pt, 0xff, end-image_pt);
 }
 
-/** Generates and writes the image MD5 checksum */
-void put_md5(uint8_t *md5, uint8_t *buffer, unsigned int len) {
+/** Generates and writes the MD5 checksum of the image data starting at offset */
+void put_md5(uint8_t *md5, const struct image_vec *image, size_t offset) {
 	MD5_CTX ctx;
+	size_t i;
 
 	MD5_Init(&ctx);
 	MD5_Update(&ctx, md5_salt, (unsigned int)sizeof(md5_salt));
-	MD5_Update(&ctx, buffer, len);
+
+	for (i = 0; i < image->cnt; i++) {
+		const uint8_t *data = image->iov[i].iov_base;
+		size_t len = image->iov[i].iov_len;
+
+		if (offset >= len) {
+			offset -= len;
+			continue;
+		}
+
+		MD5_Update(&ctx, data + offset, (unsigned int)(len - offset));
+		offset = 0;
+	}
+
 	MD5_Final(md5, &ctx);
 }
 
@@ -349,29 +444,32 @@ void put_md5(uint8_t *md5, uint8_t *buffer, unsigned int len) {
      1014-1813    Image partition table (2048 bytes, padded with 0xff)
      1814-xxxx    Firmware partitions
 */
-void * generate_factory_image(const unsigned char *vendor, size_t vendor_len, const struct image_partition_entry *parts, size_t *len) {
-	*len = 0x1814;
+void * generate_factory_image(const unsigned char *vendor, size_t vendor_len, const struct image_partition_entry *parts, struct image_vec *image) {
+	size_t len = 0x1814;
 
 	size_t i;
 	for (i = 0; parts[i].name; i++)
-		*len += parts[i].size;
+		len += parts[i].size;
 
-	uint8_t *image = malloc(*len);
-	if (!image)
+	uint8_t *header = malloc(0x1814);
+	if (!header)
 		error(1, errno, "malloc");
 
-	image[0] = *len >> 24;
-	image[1] = *len >> 16;
-	image[2] = *len >> 8;
-	image[3] = *len;
+	header[0] = len >> 24;
+	header[1] = len >> 16;
+	header[2] = len >> 8;
+	header[3] = len;
 
-	memcpy(image+0x14, vendor, vendor_len);
-	memset(image+0x14+vendor_len, 0xff, 4096-vendor_len);
+	memcpy(header+0x14, vendor, vendor_len);
+	memset(header+0x14+vendor_len, 0xff, 4096-vendor_len);
 
-	put_partitions(image + 0x1014, parts);
-	put_md5(image+0x04, image+0x14, *len-0x14);
+	image_vec_add(image, header, 0x1814);
+	put_partitions(header + 0x1014, parts, image);
+	assert(image->len == len);
 
-	return image;
+	put_md5(header+0x04, image, 0x14);
+
+	return header;
 }
 
 /**
@@ -381,7 +479,7 @@ void * generate_factory_image(const unsigned char *vendor, size_t vendor_len, co
    should be generalized when TP-LINK starts building its safeloader into hardware with
    different flash layouts.
 */
-void * generate_sysupgrade_image(const struct flash_partition_entry *flash_parts, const struct image_partition_entry *image_parts, size_t *len) {
+void generate_sysupgrade_image(const struct flash_partition_entry *flash_parts, const struct image_partition_entry *image_parts, struct image_vec *image) {
 	const struct flash_partition_entry *flash_os_image = &flash_parts[5];
 	const struct flash_partition_entry *flash_soft_version = &flash_parts[6];
 	const struct flash_partition_entry *flash_support_list = &flash_parts[7];
@@ -407,20 +505,49 @@ void * generate_sysupgrade_image(const struct flash_partition_entry *flash_parts
 	if (image_file_system->size > flash_file_system->size)
 		error(1, 0, "rootfs image too big (more than %u bytes)", (unsigned)flash_file_system->size);
 
-	*len = flash_file_system->base - flash_os_image->base + image_file_system->size;
+	image_vec_add_partition(image, image_os_image);
+	image_vec_pad_to(image, flash_soft_version->base - flash_os_image->base);
+	image_vec_add_partition(image, image_soft_version);
+	image_vec_pad_to(image, flash_support_list->base - flash_os_image->base);
+	image_vec_add_partition(image, image_support_list);
+	image_vec_pad_to(image, flash_file_system->base - flash_os_image->base);
+	image_vec_add_partition(image, image_file_system);
+}
 
-	uint8_t *image = malloc(*len);
-	if (!image)
-		error(1, errno, "malloc");
 
-	memset(image, 0xff, *len);
+/** Writes an image to a file, without copying the image data */
+static void write_image(const char *output, struct image_vec *image) {
+	int fd = open(output, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if (fd < 0)
+		error(1, errno, "unable to open output file");
+
+	struct iovec *iov = image->iov;
+	size_t cnt = image->cnt;
 
-	memcpy(image, image_os_image->data, image_os_image->size);
-	memcpy(image + flash_soft_version->base - flash_os_image->base, image_soft_version->data, image_soft_version->size);
-	memcpy(image + flash_support_list->base - flash_os_image->base, image_support_list->data, image_support_list->size);
-	memcpy(image + flash_file_system->base - flash_os_image->base, image_file_system->data, image_file_system->size);
+	/* writev() rather than pwritev(), which older macOS hosts lack */
+	while (cnt) {
+		ssize_t w = writev(fd, iov, cnt > IOV_MAX ? IOV_MAX : cnt);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+
+			error(1, errno, "unable to write output file");
+		}
 
-	return image;
+		while (cnt && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+
+		if (w) {
+			iov->iov_base = (uint8_t *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+
+	if (close(fd))
+		error(1, errno, "unable to write output file");
 }
 
 
@@ -434,23 +561,17 @@ static void do_cpe510(const char *output, const char *kernel_image, const char *
 	parts[3] = read_file("os-image", kernel_image, false);
 	parts[4] = read_file("file-system", rootfs_image, add_jffs2_eof);
 
-	size_t len;
-	void *image;
+	struct image_vec image = {};
+	void *header = NULL;
 	if (sysupgrade)
-		image = generate_sysupgrade_image(cpe510_partitions, parts, &len);
+		generate_sysupgrade_image(cpe510_partitions, parts, &image);
 	else
-		image = generate_factory_image(cpe510_vendor, sizeof(cpe510_vendor)-1, parts, &len);
-
-	FILE *file = fopen(output, "wb");
-	if (!file)
-		error(1, errno, "unable to open output file");
-
-	if (fwrite(image, len, 1, file) != 1)
-		error(1, 0, "unable to write output file");
+		header = generate_factory_image(cpe510_vendor, sizeof(cpe510_vendor)-1, parts, &image);
 
-	fclose(file);
+	write_image(output, &image);
 
-	free(image);
+	free(image.iov);
+	free(header);
 
 	size_t i;
 	for (i = 0; parts[i].name; i++)